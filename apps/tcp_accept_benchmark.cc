@@ -0,0 +1,140 @@
+#include "tcp_stack.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+
+using namespace std;
+using namespace std::chrono;
+
+constexpr uint32_t SERVER_IP = 0x0a000001;
+constexpr uint16_t SERVER_PORT = 80;
+constexpr uint32_t CLIENT_IP = 0x0a000002;
+constexpr uint32_t SPOOFED_NETWORK = 0x0b000000;  //!< flood SYNs come from random addresses in 11.0.0.0/8
+
+constexpr size_t HANDSHAKES = 20000;   //!< connections opened in each run
+constexpr size_t BATCH = 1000;         //!< connections opened before the server accepts them
+constexpr size_t BACKLOG = 1024;       //!< the listener's SYN backlog and accept queue
+constexpr unsigned FLOOD_SYNS = 10;    //!< spoofed SYNs per legitimate connection, in the flood run
+
+//! Hand a datagram to `to` through the wire format, as a TUN device would
+static void deliver(const InternetDatagram &sent, TCPStack &to) {
+    InternetDatagram dgram;
+    if (dgram.parse(Buffer(sent.serialize().concatenate())) != ParseResult::NoError) {
+        throw runtime_error("deliver: datagram did not parse");
+    }
+    to.datagram_received(dgram);
+}
+
+//! \brief Move the datagrams `from` has sent to `to`; those for any other address (the spoofed
+//! sources of a SYN flood) are lost
+//! \returns the number of datagrams moved
+static size_t transfer(TCPStack &from, TCPStack &to) {
+    size_t count = 0;
+    while (not from.datagrams_out().empty()) {
+        const InternetDatagram &dgram = from.datagrams_out().front();
+        if (dgram.header().dst == CLIENT_IP or dgram.header().dst == SERVER_IP) {
+            deliver(dgram, to);
+            count++;
+        }
+        from.datagrams_out().pop();
+    }
+    return count;
+}
+
+//! \returns a SYN from a random spoofed address and port, as a SYN flood sends
+static InternetDatagram spoofed_syn(mt19937 &rng) {
+    TCPSegment syn;
+    syn.header().syn = true;
+    syn.header().seqno = WrappingInt32{static_cast<uint32_t>(rng())};
+    syn.header().sport = 1024 + rng() % 60000;
+    syn.header().dport = SERVER_PORT;
+    syn.header().win = numeric_limits<uint16_t>::max();
+
+    InternetDatagram dgram;
+    dgram.header().src = SPOOFED_NETWORK | (rng() & 0x00ffffff);
+    dgram.header().dst = SERVER_IP;
+    dgram.header().len = dgram.header().hlen * 4 + syn.header().length();
+    dgram.payload() = syn.serialize(dgram.header().pseudo_cksum());
+    return dgram;
+}
+
+//! \brief Open HANDSHAKES connections to a listener, in batches of BATCH
+//! \param[in] flood_syns spoofed SYNs sent to the listener for each legitimate connection
+static void accept_benchmark(const unsigned flood_syns) {
+    TCPConfig cfg;
+    TCPStack client{cfg}, server{cfg};
+    server.listen(SERVER_PORT, BACKLOG);
+    mt19937 rng{1};
+
+    size_t accepted = 0;
+    const auto start = steady_clock::now();
+    for (size_t batch_start = 0; batch_start < HANDSHAKES; batch_start += BATCH) {
+        for (size_t i = batch_start; i < batch_start + BATCH; i++) {
+            for (unsigned j = 0; j < flood_syns; j++) {
+                deliver(spoofed_syn(rng), server);
+            }
+            client.connect({CLIENT_IP, static_cast<uint16_t>(10000 + i), SERVER_IP, SERVER_PORT});
+            transfer(client, server);
+        }
+        do {
+            while (server.accept(SERVER_PORT).has_value()) {
+                accepted++;
+            }
+        } while (transfer(server, client) + transfer(client, server) != 0);
+        while (server.accept(SERVER_PORT).has_value()) {
+            accepted++;
+        }
+    }
+    const double seconds = duration_cast<duration<double>>(steady_clock::now() - start).count();
+    if (accepted != HANDSHAKES) {
+        throw runtime_error("accept benchmark: only " + to_string(accepted) + " connections accepted");
+    }
+
+    cout << setw(6) << flood_syns << " spoofed SYNs per connection:" << fixed << setprecision(0) << setw(10)
+         << (HANDSHAKES / seconds) << " handshakes/s";
+    if (flood_syns != 0) {
+        cout << setw(12) << (HANDSHAKES * flood_syns / seconds) << " spoofed SYNs/s";
+    }
+    cout << "\n";
+
+    // close the connections, so that none is destroyed while open
+    for (size_t i = 0; i < HANDSHAKES; i++) {
+        const FourTuple tuple{CLIENT_IP, static_cast<uint16_t>(10000 + i), SERVER_IP, SERVER_PORT};
+        client.connection(tuple)->end_input_stream();
+        client.update(tuple);
+    }
+    transfer(client, server);
+    for (size_t i = 0; i < HANDSHAKES; i++) {
+        const FourTuple tuple{SERVER_IP, SERVER_PORT, CLIENT_IP, static_cast<uint16_t>(10000 + i)};
+        server.connection(tuple)->end_input_stream();
+        server.update(tuple);
+    }
+    while (transfer(server, client) + transfer(client, server) != 0) {
+    }
+    // the SYN backlog, which the flood filled, gives up on its SYN/ACKs
+    while (server.connection_count() != 0) {
+        const auto deadline = server.next_deadline_us();
+        if (not deadline.has_value()) {
+            throw runtime_error("accept benchmark: connections left without a timer");
+        }
+        server.tick_us(deadline.value());
+        transfer(server, client);
+    }
+}
+
+int main() {
+    try {
+        cout << "Handshakes over an in-process link, " << HANDSHAKES << " per run, backlog " << BACKLOG << "\n";
+        accept_benchmark(0);
+        accept_benchmark(FLOOD_SYNS);
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
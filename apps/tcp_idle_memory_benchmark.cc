@@ -0,0 +1,156 @@
+#include "tcp_stack.hh"
+
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+constexpr uint32_t SERVER_IP = 0x0a000001;
+constexpr uint16_t SERVER_PORT = 80;
+constexpr uint32_t CLIENT_IP = 0x0a010000;
+constexpr size_t PORTS_PER_CLIENT_IP = 50000;
+
+static void usage(const char *argv0) { cerr << "Usage: " << argv0 << " [connections]\n"; }
+
+//! Move every datagram `from` has sent to `to`, through the wire format as a TUN device would
+static size_t transfer(TCPStack &from, TCPStack &to) {
+    size_t count = 0;
+    while (not from.datagrams_out().empty()) {
+        InternetDatagram dgram;
+        if (dgram.parse(Buffer(from.datagrams_out().front().serialize().concatenate())) != ParseResult::NoError) {
+            throw runtime_error("transfer: datagram did not parse");
+        }
+        from.datagrams_out().pop();
+        to.datagram_received(dgram);
+        count++;
+    }
+    return count;
+}
+
+//! \returns the resident set size of this process in bytes (Linux), or 0 if it cannot be read
+static size_t resident_bytes() {
+    ifstream statm{"/proc/self/statm"};
+    size_t total_pages = 0, resident_pages = 0;
+    if (not(statm >> total_pages >> resident_pages)) {
+        return 0;
+    }
+    return resident_pages * sysconf(_SC_PAGESIZE);
+}
+
+//! \returns the mean TCPConnection::memory_usage() of the connections of `stack` identified by `tuples`
+static double mean_memory_usage(TCPStack &stack, const vector<FourTuple> &tuples) {
+    size_t total = 0;
+    for (const auto &tuple : tuples) {
+        TCPConnection &conn = *stack.connection(tuple);
+        if (conn.state() != TCPState::State::ESTABLISHED) {
+            throw runtime_error("idle memory benchmark: connection not ESTABLISHED but " + conn.state().name());
+        }
+        total += conn.memory_usage();
+    }
+    return static_cast<double>(total) / tuples.size();
+}
+
+static void idle_memory_benchmark(const size_t connections) {
+    const size_t resident_before = resident_bytes();
+
+    TCPConfig cfg;
+    TCPStack client{cfg}, server{cfg};
+    server.listen(SERVER_PORT, connections);
+
+    vector<FourTuple> client_tuples, server_tuples;
+    for (size_t i = 0; i < connections; i++) {
+        const uint32_t client_ip = CLIENT_IP + i / PORTS_PER_CLIENT_IP;
+        const uint16_t client_port = 10000 + i % PORTS_PER_CLIENT_IP;
+        client_tuples.push_back({client_ip, client_port, SERVER_IP, SERVER_PORT});
+        client.connect(client_tuples.back());
+    }
+    while (transfer(client, server) + transfer(server, client) != 0) {
+    }
+    while (const auto tuple = server.accept(SERVER_PORT)) {
+        server_tuples.push_back(tuple.value());
+    }
+    if (server_tuples.size() != connections) {
+        throw runtime_error("idle memory benchmark: only " + to_string(server_tuples.size()) + " connections accepted");
+    }
+
+    // a request and a response on every connection, as a long poll that has just been answered
+    const string request(100, 'q'), response(1000, 'r');
+    for (const auto &tuple : client_tuples) {
+        client.connection(tuple)->write(request);
+        client.update(tuple);
+    }
+    transfer(client, server);
+    for (const auto &tuple : server_tuples) {
+        TCPConnection &conn = *server.connection(tuple);
+        conn.inbound_stream().pop_output(conn.inbound_stream().buffer_size());
+        conn.write(response);
+        server.update(tuple);
+    }
+    while (transfer(server, client) + transfer(client, server) != 0) {
+    }
+    for (const auto &tuple : client_tuples) {
+        TCPConnection &conn = *client.connection(tuple);
+        conn.inbound_stream().pop_output(conn.inbound_stream().buffer_size());
+        client.update(tuple);
+    }
+    transfer(client, server);
+
+    const double client_active = mean_memory_usage(client, client_tuples);
+    const double server_active = mean_memory_usage(server, server_tuples);
+
+    // the connections stay idle long enough to free their buffers
+    client.tick_us(TCPStack::TRIM_DELAY_US);
+    server.tick_us(TCPStack::TRIM_DELAY_US);
+    if (transfer(client, server) + transfer(server, client) != 0) {
+        throw runtime_error("idle memory benchmark: idle connections sent datagrams");
+    }
+    const double client_idle = mean_memory_usage(client, client_tuples);
+    const double server_idle = mean_memory_usage(server, server_tuples);
+    const double resident = static_cast<double>(resident_bytes() - resident_before) / (2 * connections);
+
+    cout << connections << " ESTABLISHED connections on each side (sizeof(TCPConnection) = " << sizeof(TCPConnection)
+         << ")\n"
+         << fixed << setprecision(0) << "  memory_usage() just after the response: client " << client_active
+         << " bytes, server " << server_active << " bytes\n"
+         << "  memory_usage() once idle:               client " << client_idle << " bytes, server " << server_idle
+         << " bytes\n"
+         << "  growth of resident memory per connection: " << resident
+         << " bytes (with the stacks' tables, and heap freed by the connections but kept by the allocator)\n";
+
+    // close every connection, so that none is destroyed while open
+    for (const auto &tuple : client_tuples) {
+        client.connection(tuple)->end_input_stream();
+        client.update(tuple);
+    }
+    transfer(client, server);
+    for (const auto &tuple : server_tuples) {
+        server.connection(tuple)->end_input_stream();
+        server.update(tuple);
+    }
+    while (transfer(server, client) + transfer(client, server) != 0) {
+    }
+}
+
+int main(int argc, char **argv) {
+    try {
+        if (argc > 2) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        const size_t connections = argc == 2 ? stoul(argv[1]) : 10000;
+        if (connections == 0 or connections > PORTS_PER_CLIENT_IP * 256) {
+            throw runtime_error("connections must be between 1 and " + to_string(PORTS_PER_CLIENT_IP * 256));
+        }
+        idle_memory_benchmark(connections);
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
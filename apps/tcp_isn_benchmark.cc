@@ -0,0 +1,88 @@
+#include "isn_generator.hh"
+#include "tcp_connection.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+
+using namespace std;
+using namespace std::chrono;
+
+constexpr size_t ISNS = 1'000'000;        //!< ISNs generated in each ISN run
+constexpr size_t CONNECTIONS = 200'000;   //!< connections set up in each connection run
+
+//! Keeps the compiler from discarding the values a benchmark computes
+static volatile uint32_t sink = 0;
+
+static void report(const string &name, const size_t count, const steady_clock::time_point start) {
+    const double ns = duration_cast<duration<double, nano>>(steady_clock::now() - start).count() / count;
+    cout << setw(36) << name << fixed << setprecision(1) << setw(10) << ns << " ns" << setw(12) << setprecision(0)
+         << (1e9 / ns) << " /s\n";
+}
+
+//! \returns the tuple of the `i`th connection
+static FourTuple connection_tuple(const size_t i) {
+    return {0x0a000001, static_cast<uint16_t>(10000 + i % 50000), static_cast<uint32_t>(0x0a010000 + i / 50000), 80};
+}
+
+//! Time ISN generation with a random_device per ISN (as TCPSender used to) and with ISNGenerator
+static void isn_benchmark() {
+    auto start = steady_clock::now();
+    for (size_t i = 0; i < ISNS; i++) {
+        sink = sink + random_device()();
+    }
+    report("ISN from random_device", ISNS, start);
+
+    start = steady_clock::now();
+    for (size_t i = 0; i < ISNS; i++) {
+        sink = sink + ISNGenerator::global().isn(connection_tuple(i)).raw_value();
+    }
+    report("ISN from ISNGenerator", ISNS, start);
+}
+
+//! \brief Time the setup of a connection: constructing it and sending its SYN
+//! \param[in] use_random_device whether the ISN (and the source port, as CS144TCPSocket picks it)
+//! come from random_device or from ISNGenerator
+static void connection_benchmark(const bool use_random_device) {
+    TCPConfig cfg;
+    const auto start = steady_clock::now();
+    for (size_t i = 0; i < CONNECTIONS; i++) {
+        uint16_t port = 0;
+        if (use_random_device) {
+            cfg.fixed_isn = WrappingInt32{random_device()()};
+            port = random_device()();
+        } else {
+            cfg.fixed_isn = ISNGenerator::global().isn(connection_tuple(i));
+            port = ISNGenerator::global().random32();
+        }
+        TCPConnection conn{cfg};
+        conn.connect();
+        sink = sink + conn.segments_out().front().header().seqno.raw_value() + port;
+        conn.segments_out().pop();
+
+        // a RST from the peer closes it, so it is destroyed quietly
+        TCPSegment rst;
+        rst.header().rst = true;
+        rst.header().ack = true;
+        rst.header().ackno = conn.next_seqno();
+        conn.segment_received(rst);
+    }
+    report(use_random_device ? "connection setup, random_device" : "connection setup, ISNGenerator", CONNECTIONS,
+           start);
+}
+
+int main() {
+    try {
+        isn_benchmark();
+        connection_benchmark(true);
+        connection_benchmark(false);
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
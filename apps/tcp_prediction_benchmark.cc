@@ -0,0 +1,149 @@
+#include "tcp_connection.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+using namespace std;
+using namespace std::chrono;
+
+//! Segments handed to a connection in each run (keeps the stream under StreamReassembler's 2 GiB index)
+constexpr size_t SEGMENTS = 1'000'000;
+
+//! Times each run is repeated; the fastest is reported
+constexpr unsigned REPETITIONS = 5;
+
+//! Window both connections advertise (without window scaling, the most a header can carry)
+constexpr uint16_t WINDOW = numeric_limits<uint16_t>::max();
+
+//! Open `client` to `server` by moving the handshake segments between them
+static void handshake(TCPConnection &client, TCPConnection &server) {
+    client.connect();
+    for (unsigned i = 0; i < 3; i++) {
+        while (not client.segments_out().empty()) {
+            server.segment_received(client.segments_out().front());
+            client.segments_out().pop();
+        }
+        while (not server.segments_out().empty()) {
+            client.segment_received(server.segments_out().front());
+            server.segments_out().pop();
+        }
+    }
+}
+
+//! Reset both connections, so they are destroyed without an unclean shutdown
+static void reset(TCPConnection &client, TCPConnection &server) {
+    for (TCPConnection *conn : {&client, &server}) {
+        TCPSegment rst;
+        rst.header().rst = true;
+        rst.header().seqno = conn->ackno().value();
+        conn->segment_received(rst);
+    }
+}
+
+//! Print the fastest of REPETITIONS runs of `run(predicted)`
+static void report(const string &name, nanoseconds (*run)(bool), const bool predicted, const size_t segments,
+                   const size_t bytes) {
+    nanoseconds elapsed = nanoseconds::max();
+    for (unsigned i = 0; i < REPETITIONS; i++) {
+        elapsed = min(elapsed, run(predicted));
+    }
+    const double seconds = duration_cast<duration<double>>(elapsed).count();
+    cout << setw(12) << name << setw(10) << (predicted ? "fast" : "slow") << setw(12) << fixed
+         << setprecision(1) << (elapsed.count() / static_cast<double>(segments)) << " ns/segment";
+    if (bytes != 0) {
+        cout << setw(10) << setprecision(2) << (8 * bytes / seconds / 1e9) << " Gbit/s";
+    }
+    cout << "\n";
+}
+
+//! \brief Time the receipt of in-order data segments of TCPConfig::MAX_PAYLOAD_SIZE bytes
+//! \param[in] predicted if `false`, every other segment announces a different window, which
+//! sends all of them down the general path
+//! \returns the time taken
+static nanoseconds data_segments(const bool predicted) {
+    TCPConfig cfg;
+    cfg.recv_capacity = cfg.recv_capacity_max = WINDOW;
+    TCPConnection client{cfg}, server{cfg};
+    handshake(client, server);
+
+    TCPSegment seg;
+    seg.header().ack = true;
+    seg.header().ackno = server.next_seqno();
+    seg.header().seqno = server.ackno().value();
+    seg.payload() = Buffer(string(TCPConfig::MAX_PAYLOAD_SIZE, 'x'));
+
+    const auto start = steady_clock::now();
+    for (size_t i = 0; i < SEGMENTS; i++) {
+        seg.header().win = (predicted or i % 2 == 0) ? WINDOW : WINDOW - 1;
+        server.segment_received(seg);
+        seg.header().seqno = seg.header().seqno + TCPConfig::MAX_PAYLOAD_SIZE;
+        server.inbound_stream().pop_output(server.inbound_stream().buffer_size());
+        while (not server.segments_out().empty()) {
+            server.segments_out().pop();
+        }
+    }
+    const auto elapsed = steady_clock::now() - start;
+
+    if (server.inbound_stream().bytes_read() != SEGMENTS * TCPConfig::MAX_PAYLOAD_SIZE) {
+        throw runtime_error("data segments: bytes were lost");
+    }
+    reset(client, server);
+    return elapsed;
+}
+
+//! \brief Time the receipt of pure ACKs that each acknowledge one TCPConfig::MAX_PAYLOAD_SIZE segment
+//! \param[in] predicted if `false`, every other ACK announces a different window, which sends all
+//! of them down the general path
+//! \returns the time taken
+static nanoseconds pure_acks(const bool predicted) {
+    TCPConfig cfg;
+    cfg.send_capacity = cfg.send_capacity_max = 4 * WINDOW;
+    TCPConnection client{cfg}, server{cfg};
+    handshake(client, server);
+
+    const string chunk(WINDOW, 'x');
+    TCPSegment ack;
+    ack.header().ack = true;
+    ack.header().seqno = server.next_seqno();
+    ack.header().ackno = client.next_seqno();
+    ack.header().win = WINDOW;
+
+    nanoseconds elapsed{0};
+    size_t acks = 0;
+    while (acks < SEGMENTS) {
+        // fill the window, then acknowledge it one segment at a time
+        client.write(chunk);
+        while (not client.segments_out().empty()) {
+            client.segments_out().pop();
+        }
+        const auto start = steady_clock::now();
+        while (client.bytes_in_flight() >= TCPConfig::MAX_PAYLOAD_SIZE) {
+            ack.header().ackno = ack.header().ackno + TCPConfig::MAX_PAYLOAD_SIZE;
+            ack.header().win = (predicted or acks % 2 == 0) ? WINDOW : WINDOW - 1;
+            client.segment_received(ack);
+            acks++;
+        }
+        elapsed += steady_clock::now() - start;
+    }
+
+    reset(client, server);
+    return elapsed * SEGMENTS / acks;
+}
+
+int main() {
+    try {
+        cout << "Header prediction: " << SEGMENTS << " segments per run, best of " << REPETITIONS << "\n";
+        report("data", data_segments, true, SEGMENTS, SEGMENTS * TCPConfig::MAX_PAYLOAD_SIZE);
+        report("data", data_segments, false, SEGMENTS, SEGMENTS * TCPConfig::MAX_PAYLOAD_SIZE);
+        report("pure ACK", pure_acks, true, SEGMENTS, 0);
+        report("pure ACK", pure_acks, false, SEGMENTS, 0);
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
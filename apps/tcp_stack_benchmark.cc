@@ -0,0 +1,147 @@
+#include "tcp_stack.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+constexpr uint32_t SERVER_IP = 0x0a000001;
+constexpr uint16_t SERVER_PORT = 80;
+constexpr uint32_t CLIENT_IP = 0x0a010000;
+constexpr size_t PORTS_PER_CLIENT_IP = 50000;
+
+constexpr unsigned ROUNDS = 20;          //!< rounds of traffic, in each of which every connection sends a message
+constexpr size_t MESSAGE_SIZE = 1000;    //!< bytes each connection sends per round
+constexpr unsigned IDLE_TICKS = 10000;   //!< 1 ms ticks timed with every connection idle
+
+static void usage(const char *argv0) { cerr << "Usage: " << argv0 << " [connections]\n"; }
+
+//! \brief Move every datagram `from` has sent to `to`, through the wire format as a TUN device would
+//! \returns the number of datagrams moved
+static size_t transfer(TCPStack &from, TCPStack &to) {
+    size_t count = 0;
+    while (not from.datagrams_out().empty()) {
+        InternetDatagram dgram;
+        if (dgram.parse(Buffer(from.datagrams_out().front().serialize().concatenate())) != ParseResult::NoError) {
+            throw runtime_error("transfer: datagram did not parse");
+        }
+        from.datagrams_out().pop();
+        to.datagram_received(dgram);
+        count++;
+    }
+    return count;
+}
+
+static double elapsed_seconds(const steady_clock::time_point start) {
+    return duration_cast<duration<double>>(steady_clock::now() - start).count();
+}
+
+static void stack_benchmark(const size_t connections) {
+    TCPConfig cfg;
+    TCPStack client{cfg}, server{cfg};
+    server.listen(SERVER_PORT, connections);
+
+    vector<FourTuple> client_tuples, server_tuples;
+    client_tuples.reserve(connections);
+    server_tuples.reserve(connections);
+
+    // open every connection
+    auto start = steady_clock::now();
+    for (size_t i = 0; i < connections; i++) {
+        const uint32_t client_ip = CLIENT_IP + i / PORTS_PER_CLIENT_IP;
+        const uint16_t client_port = 10000 + i % PORTS_PER_CLIENT_IP;
+        client_tuples.push_back({client_ip, client_port, SERVER_IP, SERVER_PORT});
+        client.connect(client_tuples.back());
+    }
+    while (transfer(client, server) + transfer(server, client) != 0) {
+    }
+    while (const auto tuple = server.accept(SERVER_PORT)) {
+        server_tuples.push_back(tuple.value());
+    }
+    const double setup_time = elapsed_seconds(start);
+    if (server_tuples.size() != connections) {
+        throw runtime_error("stack benchmark: only " + to_string(server_tuples.size()) + " connections accepted");
+    }
+
+    // every connection sends a message per round, and the server reads it
+    const string message(MESSAGE_SIZE, 'x');
+    size_t datagrams = 0;
+    size_t bytes_read = 0;
+    start = steady_clock::now();
+    for (unsigned round = 0; round < ROUNDS; round++) {
+        for (const auto &tuple : client_tuples) {
+            client.connection(tuple)->write(message);
+            client.update(tuple);
+        }
+        datagrams += transfer(client, server);
+        for (const auto &tuple : server_tuples) {
+            ByteStream &inbound = server.connection(tuple)->inbound_stream();
+            bytes_read += inbound.buffer_size();
+            inbound.pop_output(inbound.buffer_size());
+            server.update(tuple);
+        }
+        datagrams += transfer(server, client);
+    }
+    const double traffic_time = elapsed_seconds(start);
+    if (bytes_read != size_t{ROUNDS} * connections * MESSAGE_SIZE) {
+        throw runtime_error("stack benchmark: bytes were lost");
+    }
+
+    // time passes with nothing to send, once the connections have freed their queues
+    client.tick_us(TCPStack::TRIM_DELAY_US);
+    server.tick_us(TCPStack::TRIM_DELAY_US);
+    start = steady_clock::now();
+    for (unsigned i = 0; i < IDLE_TICKS; i++) {
+        client.tick(1);
+        server.tick(1);
+    }
+    const double idle_time = elapsed_seconds(start);
+    if (transfer(client, server) + transfer(server, client) != 0) {
+        throw runtime_error("stack benchmark: idle connections sent datagrams");
+    }
+
+    // close every connection, client first
+    for (const auto &tuple : client_tuples) {
+        client.connection(tuple)->end_input_stream();
+        client.update(tuple);
+    }
+    transfer(client, server);
+    for (const auto &tuple : server_tuples) {
+        server.connection(tuple)->end_input_stream();
+        server.update(tuple);
+    }
+    while (transfer(server, client) + transfer(client, server) != 0) {
+    }
+    if (client.connection_count() + server.connection_count() != 0) {
+        throw runtime_error("stack benchmark: connections did not close");
+    }
+
+    cout << setw(8) << connections << " connections:" << fixed << setprecision(1) << setw(10)
+         << (setup_time * 1e3) << " ms to open," << setw(8) << (traffic_time * 1e9 / datagrams)
+         << " ns/datagram (" << setprecision(2) << (datagrams / traffic_time / 1e6) << " M/s)," << setprecision(1)
+         << setw(8) << (idle_time * 1e9 / (2 * IDLE_TICKS)) << " ns per idle tick\n";
+}
+
+int main(int argc, char **argv) {
+    try {
+        if (argc > 2) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        const size_t connections = argc == 2 ? stoul(argv[1]) : 10000;
+        if (connections == 0 or connections > PORTS_PER_CLIENT_IP * 256) {
+            throw runtime_error("connections must be between 1 and " + to_string(PORTS_PER_CLIENT_IP * 256));
+        }
+        stack_benchmark(connections);
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -6,81 +6,102 @@
 // Implementation of a flow-controlled in-memory byte stream.
 
 // Passes automated checks run by `make check_lab0`.
-// Changed from Linked List of Char nodes to Linked List of String nodes to resolve Lab1 timeout issue
+// The bytes are kept in fixed-size chunks taken from a shared ChunkPool: an idle stream holds
+// no storage, and chunks go back to the pool as soon as they have been read
 
 ByteStream::ByteStream(const size_t capacity) {
     _capacity = capacity; 
-    if(capacity==0)
-        return;
-    ll = make_unique<Node>("");
-    write_ptr = &ll;
-    read_ptr  = &ll;
     num_pop = 0, num_write = 0;
 }
 
+ByteStream &ByteStream::operator=(ByteStream &&b) {
+    if(this != &b)
+    {
+        while(!_chunks.empty())
+        {
+            ChunkPool::release(move(_chunks.front()));
+            _chunks.pop();
+        }
+        _chunks = move(b._chunks);
+        _charge = move(b._charge);
+        _head = b._head;
+        num_write = b.num_write;
+        num_pop = b.num_pop;
+        _capacity = b._capacity;
+        _error = b._error;
+        _end_input = b._end_input;
+    }
+    return *this;
+}
+
+ByteStream::~ByteStream() {
+    while(!_chunks.empty())
+    {
+        ChunkPool::release(move(_chunks.front()));
+        _chunks.pop();
+    }
+}
+
 size_t ByteStream::write(const string &data) {
-    size_t sz = data.size();
-    size_t write_size = min(sz, remaining_capacity());
-    if(remaining_capacity()>0)
+    const size_t write_size = min(data.size(), remaining_capacity());
+    size_t written = 0;
+    while(written < write_size)
     {
-        (*write_ptr)->next = make_unique<Node>(data.substr(0, write_size));
-        num_write+= write_size;
-        write_ptr = &((*write_ptr)->next);
-        return write_size;
+        const size_t tail = _head + buffer_size();  // offset of the next byte, counted from the front chunk
+        if(tail == _chunks.size() * ChunkPool::CHUNK_SIZE)
+        {
+            _chunks.push(ChunkPool::acquire());
+            _charge.set(_chunks.size() * ChunkPool::CHUNK_SIZE);
+        }
+        const size_t offset = tail % ChunkPool::CHUNK_SIZE;
+        const size_t n = min(write_size - written, ChunkPool::CHUNK_SIZE - offset);
+        copy_n(data.data() + written, n, _chunks.back().get() + offset);
+        written += n;
+        num_write += n;
     }
-    return 0;
+    return write_size;
 }
 
 //! \param[in] len bytes will be copied from the output side of the buffer
 string ByteStream::peek_output(const size_t len) const {
-    string peek_data = "";
-    size_t read_num = 0;
-    size_t read_len = min(len, buffer_size());
-    std::unique_ptr<Node>* oread_ptr = (read_ptr);
-    while((!buffer_empty() || (oread_ptr!=write_ptr)) && read_num < read_len)
+    const size_t read_len = min(len, buffer_size());
+    string peek_data;
+    peek_data.reserve(read_len);
+    for(size_t pos = _head; peek_data.size() < read_len;)
     {
-        oread_ptr = &((*oread_ptr)->next);
-        string oread_string = (*oread_ptr)->val;
-        size_t oread_size = oread_string.size();
-        if(read_num + oread_size <= read_len)
-        {
-            peek_data+= oread_string;
-            read_num+=oread_size;
-        }
-        else
-        {
-            size_t read_size =  (read_len - read_num);
-            peek_data+= oread_string.substr(0, read_size);
-            read_num+= read_size;
-        }
+        const size_t offset = pos % ChunkPool::CHUNK_SIZE;
+        const size_t n = min(read_len - peek_data.size(), ChunkPool::CHUNK_SIZE - offset);
+        peek_data.append(_chunks[pos / ChunkPool::CHUNK_SIZE].get() + offset, n);
+        pos += n;
     }
     return peek_data;
 }
 
 //! \param[in] len bytes will be removed from the output side of the buffer
 void ByteStream::pop_output(const size_t len) { 
-    size_t read_num = 0;
-    size_t read_len = min(len, buffer_size());
-    while((!buffer_empty() ||(read_ptr!=write_ptr)) && read_num < read_len)
+    const size_t pop_len = min(len, buffer_size());
+    _head += pop_len;
+    num_pop += pop_len;
+    release_read_chunks();
+}
+
+void ByteStream::release_read_chunks() {
+    if(buffer_empty())
     {
-        std::unique_ptr<Node>* read_ptr_cpy = read_ptr;
-        read_ptr = &((*read_ptr)->next);
-        string read_string = (*read_ptr)->val;
-        size_t read_size = read_string.size();
-        if(read_num + read_size <= read_len)
-        {
-            read_num+=read_size;
-            num_pop+=read_size;
-        }
-        else
+        while(!_chunks.empty())
         {
-            read_size =  (read_len - read_num);
-            (*read_ptr)->val = read_string.substr(read_size, string::npos);
-            read_ptr = read_ptr_cpy;
-            read_num+= read_size;
-            num_pop+= read_size;
+            ChunkPool::release(move(_chunks.front()));
+            _chunks.pop();
         }
+        _head = 0;
+    }
+    while(_head >= ChunkPool::CHUNK_SIZE)
+    {
+        ChunkPool::release(move(_chunks.front()));
+        _chunks.pop();
+        _head -= ChunkPool::CHUNK_SIZE;
     }
+    _charge.set(_chunks.size() * ChunkPool::CHUNK_SIZE);
 }
 
 void ByteStream::end_input() {_end_input = true;}
@@ -97,4 +118,4 @@ size_t ByteStream::bytes_written() const { return num_write; }
 
 size_t ByteStream::bytes_read() const { return num_pop ; }
 
-size_t ByteStream::remaining_capacity() const { return _capacity - buffer_size(); }
+size_t ByteStream::remaining_capacity() const { return (_capacity > buffer_size()) ? _capacity - buffer_size() : 0; }
@@ -1,11 +1,14 @@
 #ifndef SPONGE_LIBSPONGE_BYTE_STREAM_HH
 #define SPONGE_LIBSPONGE_BYTE_STREAM_HH
 
+#include "chunk_pool.hh"
+#include "memory_budget.hh"
+#include "ring_queue.hh"
+
 #include <cstddef>
 #include <cstdint>
 #include <string>
 #include <utility>
-#include <memory>
 
 //! \brief An in-order byte stream.
 
@@ -15,31 +18,27 @@
 using namespace std;
 class ByteStream {
   private:
-    struct Node
-    {
-        string val;
-        std::unique_ptr<Node> next; 
-        Node(string s) : val(s), next(nullptr) {};
-    };
-    std::unique_ptr<Node> ll{};
-    std::unique_ptr<Node>* read_ptr{};
-    std::unique_ptr<Node>* write_ptr{};
+    //! Buffered bytes, in chunks from the ChunkPool; a chunk is taken when a write needs room and
+    //! given back once it has been read, so a drained stream holds no chunks
+    RingQueue<ChunkPool::Chunk> _chunks{4};
+    MemoryCharge _charge{};  //!< the chunks held, charged to the global MemoryBudget
+    size_t _head{};  //!< offset in the front chunk of the first unread byte
     size_t num_write{}, num_pop{};
     size_t _capacity{};
 
     bool _error{};  //!< Flag indicating that the stream suffered an error.
     bool _end_input{};
 
+    //! Give back the chunks that hold no unread bytes
+    void release_read_chunks();
+
   public:
-    //! Copy Constructor
-    ByteStream(const ByteStream &b)
-    {   
-        *this =b; ;
-    }
-    ByteStream& operator= (const ByteStream &b)
-    {   
-        return *this=b;
-    }
+    ByteStream(const ByteStream &b) = delete;
+    ByteStream &operator=(const ByteStream &b) = delete;
+    ByteStream(ByteStream &&b) = default;
+    ByteStream &operator=(ByteStream &&b);
+    ~ByteStream();
+
     //! Construct a stream with room for `capacity` bytes.
     ByteStream(const size_t capacity);
 
@@ -54,6 +53,12 @@ class ByteStream {
     //! \returns the number of additional bytes that the stream has space for
     size_t remaining_capacity() const;
 
+    //! Change the capacity; bytes already buffered beyond a smaller capacity are kept
+    void set_capacity(const size_t capacity) { _capacity = capacity; }
+
+    //! \returns the capacity of the stream
+    size_t capacity() const { return _capacity; }
+
     //! Signal that the byte stream has reached its ending
     void end_input();
 
@@ -103,6 +108,12 @@ class ByteStream {
 
     //! Total number of bytes popped
     size_t bytes_read() const;
+
+    //! Free the (small) table of chunks if the stream is empty; chunks themselves are given back as they are read
+    void shrink_to_fit() { _chunks.shrink_to_fit(); }
+
+    //! Bytes of heap storage held by the stream
+    size_t memory_usage() const { return _chunks.size() * ChunkPool::CHUNK_SIZE + _chunks.capacity() * sizeof(ChunkPool::Chunk); }
     //!@}
 };
 
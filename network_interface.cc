@@ -14,6 +14,10 @@ void DUMMY_CODE(Targs &&... /* unused */) {}
 
 using namespace std;
 constexpr EthernetAddress ETHERNET_ARP = {0, 0, 0, 0, 0, 0};
+//! How long a learned ARP mapping is kept, in microseconds
+constexpr uint64_t ARP_ENTRY_TTL_US = 30000 * 1000;
+//! How long to wait before repeating an ARP request for the same address, in microseconds
+constexpr uint64_t ARP_REQUEST_INTERVAL_US = 5000 * 1000;
 
 
 //! \param[in] ethernet_address Ethernet (what ARP calls "hardware") address of the interface
@@ -42,7 +46,7 @@ void NetworkInterface::send_datagram(const InternetDatagram &dgram, const Addres
     else
     {
         _ip_addr_list_dgram_map[next_hop_ip].push_back(dgram);
-        if(_ip_addr_arp_req_time.count(next_hop_ip) && (_curr_time - _ip_addr_arp_req_time[next_hop_ip] <5000))
+        if(_ip_addr_arp_req_time.count(next_hop_ip) && (_curr_time - _ip_addr_arp_req_time[next_hop_ip] < ARP_REQUEST_INTERVAL_US))
             return;
         send_arp(ETHERNET_ARP, next_hop_ip, ARPMessage::OPCODE_REQUEST);
         _ip_addr_arp_req_time[next_hop_ip] = _curr_time;
@@ -90,10 +94,10 @@ optional<InternetDatagram> NetworkInterface::recv_frame(const EthernetFrame &fra
     return {};
 }
 
-//! \param[in] ms_since_last_tick the number of milliseconds since the last call to this method
-void NetworkInterface::tick(const size_t ms_since_last_tick) { 
-    _curr_time+=ms_since_last_tick;
-    while(!_time_arp_entry.empty() && (_curr_time - _time_arp_entry.front().first > 30000))
+//! \param[in] us_since_last_tick the number of microseconds since the last call to this method
+void NetworkInterface::tick_us(const uint64_t us_since_last_tick) { 
+    _curr_time+=us_since_last_tick;
+    while(!_time_arp_entry.empty() && (_curr_time - _time_arp_entry.front().first > ARP_ENTRY_TTL_US))
     {
         uint32_t next_hop_ip = _time_arp_entry.front().second;
         if(_ip_addr_arp_entry_time[next_hop_ip] == _time_arp_entry.front().first)
@@ -102,6 +106,21 @@ void NetworkInterface::tick(const size_t ms_since_last_tick) {
     }
 }
 
+optional<size_t> NetworkInterface::next_deadline() const {
+    const auto deadline = next_deadline_us();
+    if(!deadline.has_value())
+        return {};
+    return (deadline.value() + 999) / 1000;
+}
+
+optional<uint64_t> NetworkInterface::next_deadline_us() const {
+    if(_time_arp_entry.empty())
+        return {};
+    // tick_us() expires an entry once it is more than ARP_ENTRY_TTL_US old
+    const uint64_t expiry = _time_arp_entry.front().first + ARP_ENTRY_TTL_US + 1;
+    return (expiry > _curr_time) ? (expiry - _curr_time) : 0;
+}
+
 void NetworkInterface::send_arp(EthernetAddress target_address, uint32_t next_hop_ip, uint16_t arp_opcode) {
     EthernetFrame efrm ;
     efrm.header().src = _ethernet_address;
@@ -49,16 +49,16 @@ class NetworkInterface {
     std::unordered_map<uint32_t, std::list<InternetDatagram> > _ip_addr_list_dgram_map{};
 
     //! Queue to store when arp entry was added
-    std::queue< std::pair<size_t, uint32_t> > _time_arp_entry{};
+    std::queue< std::pair<uint64_t, uint32_t> > _time_arp_entry{};
 
     //! Map to store when last ARP request was sent for a particular IP address
-    std::unordered_map<uint32_t, size_t> _ip_addr_arp_req_time{};
+    std::unordered_map<uint32_t, uint64_t> _ip_addr_arp_req_time{};
 
     //! Map to store when last ARP entry was added for a particular IP address
-    std::unordered_map<uint32_t, size_t> _ip_addr_arp_entry_time{};
+    std::unordered_map<uint32_t, uint64_t> _ip_addr_arp_entry_time{};
 
-    //! Current Time; updated in tick() call
-    size_t _curr_time{0};
+    //! Current Time, in microseconds; updated in tick() call
+    uint64_t _curr_time{0};
 
     //! Send ARP request/reply
     void send_arp(EthernetAddress target_address, uint32_t next_hop_ip, uint16_t arp_opcode);
@@ -70,6 +70,9 @@ class NetworkInterface {
     //! \brief Access queue of Ethernet frames awaiting transmission
     std::queue<EthernetFrame> &frames_out() { return _frames_out; }
 
+    //! \brief Access queue of Ethernet frames awaiting transmission
+    const std::queue<EthernetFrame> &frames_out() const { return _frames_out; }
+
     //! \brief Sends an IPv4 datagram, encapsulated in an Ethernet frame (if it knows the Ethernet destination address).
 
     //! Will need to use [ARP](\ref rfc::rfc826) to look up the Ethernet destination address for the next hop
@@ -84,7 +87,16 @@ class NetworkInterface {
     std::optional<InternetDatagram> recv_frame(const EthernetFrame &frame);
 
     //! \brief Called periodically when time elapses
-    void tick(const size_t ms_since_last_tick);
+    void tick(const size_t ms_since_last_tick) { tick_us(ms_since_last_tick * 1000); }
+
+    //! \brief Called periodically when time elapses, with microsecond resolution
+    void tick_us(const uint64_t us_since_last_tick);
+
+    //! \brief Milliseconds until tick() next expires an ARP entry (empty if there are none)
+    std::optional<size_t> next_deadline() const;
+
+    //! \brief Microseconds until tick_us() next expires an ARP entry (empty if there are none)
+    std::optional<uint64_t> next_deadline_us() const;
 };
 
 #endif  // SPONGE_LIBSPONGE_NETWORK_INTERFACE_HH
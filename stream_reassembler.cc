@@ -15,15 +15,23 @@ StreamReassembler::StreamReassembler(const size_t capacity) : _output(capacity),
 //! possibly out-of-order, from the logical stream, and assembles any newly
 //! contiguous substrings and writes them into the output stream in order.
 void StreamReassembler::push_substring(const string &data, const size_t index, const bool eof) {
+    assemble(data, index, eof);
+    _charge.set(unassembled_bytes());
+}
+
+void StreamReassembler::assemble(const string &data, const size_t index, const bool eof) {
     size_t sz = data.size();
     size_t index_end = index + sz - 1;
     size_t bsz; // Used to store the size of substring to be extracted from data
     //Handle the case where EOF is encountered but nothing from data is to be copied
     if(sz==0 || (last_assembled!=-1 && index_end<=static_cast<size_t>(last_assembled)))
     {
-        if(!eof_seen)
-            eof_seen = eof; 
-        if(eof_seen && unassembled_bytes()==0)
+        if(!eof_seen && eof)
+        {
+            eof_seen = true;
+            eof_index = index + sz;
+        }
+        if(eof_seen && _output.bytes_written()==eof_index)
         {
             _output.end_input();
         }
@@ -51,9 +59,12 @@ void StreamReassembler::push_substring(const string &data, const size_t index, c
                 intervals.insert(intervals.end(), new_interval);
 
         }
-        if(!eof_seen)
-            eof_seen = eof; 
-        if(eof_seen && unassembled_bytes()==0)
+        if(!eof_seen && eof)
+        {
+            eof_seen = true;
+            eof_index = index + sz;
+        }
+        if(eof_seen && _output.bytes_written()==eof_index)
         {
             _output.end_input();
         }
@@ -197,15 +208,18 @@ void StreamReassembler::push_substring(const string &data, const size_t index, c
         
             
 
-    if(!eof_seen)
-        eof_seen = eof; 
+    if(!eof_seen && eof)
+    {
+        eof_seen = true;
+        eof_index = index + sz;
+    }
     if(last_assembled_it!=intervals.end())
     {
         _output.write(move(last_assembled_it->buffer));
         last_assembled = static_cast<int>(last_assembled_it->end);
         intervals.erase(last_assembled_it);
     }
-    if(eof_seen && unassembled_bytes()==0)
+    if(eof_seen && _output.bytes_written()==eof_index)
     {
         _output.end_input();
     }
@@ -217,3 +231,10 @@ void StreamReassembler::push_substring(const string &data, const size_t index, c
 size_t StreamReassembler::unassembled_bytes() const { return total_bytes_rcvd - (last_assembled + 1); }
 
 bool StreamReassembler::empty() const { return (unassembled_bytes()==0); }
+
+size_t StreamReassembler::memory_usage() const {
+    size_t usage = _output.memory_usage();
+    for(const auto &i : intervals)
+        usage += sizeof(i) + 2 * sizeof(void *) + i.buffer.capacity();  // list node: interval and links
+    return usage;
+}
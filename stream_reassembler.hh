@@ -2,6 +2,7 @@
 #define SPONGE_LIBSPONGE_STREAM_REASSEMBLER_HH
 
 #include "byte_stream.hh"
+#include "memory_budget.hh"
 
 #include <cstdint>
 #include <string>
@@ -26,7 +27,12 @@ class StreamReassembler {
     int last_assembled;  //!< Index till which contiguous bytes have been seen
     int total_bytes_rcvd;//!< Number of bytes received till now
     bool eof_seen{}; //!< Set once an eof is seen
+    size_t eof_index{}; //!< Index just past the last byte of the stream, once an eof is seen
     list<interval> intervals; //!< List of intervals which are yet to be reassembled
+    MemoryCharge _charge{}; //!< The unassembled bytes, charged to the global MemoryBudget
+
+    //! Store the substring and write any newly contiguous bytes into the stream
+    void assemble(const std::string &data, const uint64_t index, const bool eof);
     
         
 
@@ -63,6 +69,9 @@ class StreamReassembler {
     //! \brief Is the internal state empty (other than the output stream)?
     //! \returns `true` if no substrings are waiting to be assembled
     bool empty() const;
+
+    //! Bytes of heap storage held by the output stream and the substrings waiting to be assembled
+    size_t memory_usage() const;
 };
 
 #endif  // SPONGE_LIBSPONGE_STREAM_REASSEMBLER_HH
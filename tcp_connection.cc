@@ -1,5 +1,6 @@
 #include "tcp_connection.hh"
 #include <iostream>
+#include <limits>
 
 
 // passes automated checks run by `make check_lab4`.
@@ -7,16 +8,108 @@
 using namespace std;
 size_t TCPConnection::remaining_outbound_capacity() const { return _sender.stream_in().remaining_capacity(); }
 
+size_t TCPConnection::remaining_notsent_capacity() const {
+    const size_t notsent = _sender.stream_in().buffer_size();
+    const size_t headroom = (_cfg.notsent_lowat > notsent) ? (_cfg.notsent_lowat - notsent) : 0;
+    return min(headroom, remaining_outbound_capacity());
+}
+
 size_t TCPConnection::bytes_in_flight() const { return _sender.bytes_in_flight(); }
 
 size_t TCPConnection::unassembled_bytes() const { return _receiver.unassembled_bytes(); }
 
-size_t TCPConnection::time_since_last_segment_received() const { return _time_connection_alive - _time_since_last_segment_received; }
+size_t TCPConnection::time_since_last_segment_received() const { return time_since_last_segment_received_us() / 1000; }
+
+//! \details With TCPConfig::metrics, the sender starts from its RTT estimates and the receive
+//! buffer from its auto-tuned capacity.
+TCPConnection::TCPConnection(const TCPConfig &cfg) : _cfg{cfg} {
+    if(_cfg.metrics.has_value())
+        _receiver.warm_start(_cfg.metrics->recv_capacity);
+}
+
+TCPMetrics TCPConnection::metrics() const {
+    return {_sender.srtt_us(), _sender.rttvar_us(), _receiver.capacity(), _sender.peer_window()};
+}
+
+size_t TCPConnection::memory_usage() const {
+    return sizeof(*this) + _sender.memory_usage() + _receiver.memory_usage() + _segments_out.capacity() * sizeof(TCPSegment);
+}
+
+void TCPConnection::shrink_to_fit() {
+    _sender.shrink_to_fit();
+    _receiver.stream_out().shrink_to_fit();
+    _segments_out.shrink_to_fit();
+}
+
+void TCPConnection::set_output_blocked(const bool blocked)
+{
+    if(blocked == _sender.output_blocked())
+        return;
+    _sender.set_output_blocked(blocked);
+    if(!blocked)
+    {
+        _sender.fill_window();
+        fill_queue();
+    }
+}
+
+//! \details Van Jacobson-style header prediction: in ESTABLISHED (SYN received, neither stream
+//! ended), with only ACK (and maybe PSH) set and an unchanged window, a segment is either the next
+//! in-order payload that acknowledges nothing new, or a pure ACK that advances snd_una. Both are
+//! handled with a few comparisons and without unwrap(); everything else, including any segment
+//! that may take part in a close, takes the general path.
+//! \returns `true` if the segment was handled
+bool TCPConnection::header_predicted(const TCPSegment &seg)
+{
+    const TCPHeader &h = seg.header();
+    if(!h.ack || h.syn || h.fin || h.rst || h.urg || _send_rst || !_connect_initiated || h.win!=_sender.peer_window())
+        return false;
+    if(!_receiver.ackno().has_value() || _receiver.stream_out().input_ended() || _sender.stream_in().input_ended())
+        return false;
+    if(seg.payload().size()==0)
+    {
+        //Pure ACK for new data
+        if(!_sender.predicted_ack_received(h.ackno))
+            return false;
+        _fill_window_pending = true;
+        return true;
+    }
+    //Next in-order data, nothing new acknowledged
+    if(h.ackno!=_sender.unacked_seqno() || !_sender.syn_acked() || !_receiver.predicted_segment_received(h.seqno, seg.payload()))
+        return false;
+    if(_segments_out.empty())
+        _ack_pending = true;
+    return true;
+}
 
 void TCPConnection::segment_received(const TCPSegment &seg) 
+{
+    receive(seg);
+    flush_received();
+}
+
+//! \details The segments are processed in order, but the window is filled, an ACK is generated and
+//! the output is handed to segments_out() only once, after the last of them; so a burst read from
+//! the network produces one burst of output instead of one ACK per segment.
+void TCPConnection::segments_received(const vector<TCPSegment> &segs)
+{
+    for(const auto &seg : segs)
+    {
+        if(_is_rst_seen)
+            break;
+        receive(seg);
+    }
+    flush_received();
+}
+
+//! Process one segment, leaving any window filling or ACK it calls for pending
+void TCPConnection::receive(const TCPSegment &seg)
 {
     _time_since_last_segment_received = _time_connection_alive;
-    TCPHeader segment_header = seg.header();
+    _keepalive_probes_sent = 0;
+    if(header_predicted(seg))
+        return;
+    const TCPHeader &segment_header = seg.header();
     bool send_empty = false;
     bool ack_rcvd_status = false;
     //check ack only if SYN has been received
@@ -25,7 +118,7 @@ void TCPConnection::segment_received(const TCPSegment &seg)
         ack_rcvd_status = _sender.ack_received(segment_header.ackno, segment_header.win);
         if(ack_rcvd_status)
         {
-            _sender.fill_window();
+            _fill_window_pending = true;
         }
         else
             send_empty = true; 
@@ -66,8 +159,7 @@ void TCPConnection::segment_received(const TCPSegment &seg)
          
 
     if(send_empty)
-        _sender.send_empty_segment();
-    fill_queue();
+        _ack_pending = true;
     if(segment_header.fin && (!_sender.stream_in().eof() && _connect_initiated))
     {
         _linger_after_streams_finish = false;
@@ -76,11 +168,27 @@ void TCPConnection::segment_received(const TCPSegment &seg)
 }
 
 
+//! Carry out the window filling and ACK left pending by receive(), and queue the output
+void TCPConnection::flush_received()
+{
+    if(_is_rst_seen)
+    {
+        _fill_window_pending = _ack_pending = false;
+        return;
+    }
+    if(_fill_window_pending)
+        _sender.fill_window();
+    if(_ack_pending)
+        _sender.send_empty_segment();
+    _fill_window_pending = _ack_pending = false;
+    fill_queue();
+}
+
 bool TCPConnection::active() const
 { 
     bool unclean_shutdown = _is_rst_seen;
     bool clean_shutdown = (unassembled_bytes()==0) && _receiver.stream_out().eof() && _sender.stream_in().eof() && (bytes_in_flight()==0);
-    clean_shutdown &= ((!_linger_after_streams_finish) || (time_since_last_segment_received() >= 10*_cfg.rt_timeout));
+    clean_shutdown &= ((!_linger_after_streams_finish) || (time_since_last_segment_received_us() >= 10*_cfg.initial_rto_us()));
     return (!unclean_shutdown) && (!clean_shutdown) && (!_send_rst);
 }
 
@@ -93,14 +201,84 @@ size_t TCPConnection::write(const string &data) {
     return write_size;
 }
 
-//! \param[in] ms_since_last_tick number of milliseconds since the last call to this method
-void TCPConnection::tick(const size_t ms_since_last_tick) 
+//! \param[in] us_since_last_tick number of microseconds since the last call to this method
+void TCPConnection::tick_us(const uint64_t us_since_last_tick) 
 { 
-    _time_connection_alive += ms_since_last_tick;
-    _sender.tick(ms_since_last_tick);
+    _time_connection_alive += us_since_last_tick;
+    _sender.tick_us(us_since_last_tick);
+    _receiver.set_rtt_estimate_us(_sender.srtt_us() ? _sender.srtt_us() : _cfg.initial_rto_us());
+    _receiver.tick_us(us_since_last_tick);
+    if(active())
+        keepalive();
     fill_queue();
 }
 
+optional<size_t> TCPConnection::next_deadline() const
+{
+    const auto deadline = next_deadline_us();
+    if(!deadline.has_value())
+        return {};
+    return (deadline.value() + 999) / 1000;
+}
+
+optional<uint64_t> TCPConnection::next_deadline_us() const
+{
+    const optional<uint64_t> transfer = transfer_deadline_us();
+    if(transfer.has_value())
+        return transfer;
+    return keepalive_deadline_us();
+}
+
+optional<uint64_t> TCPConnection::transfer_deadline_us() const
+{
+    if(!active())
+        return {};
+    optional<uint64_t> deadline = _sender.next_deadline_us();
+    const bool streams_finished = (unassembled_bytes()==0) && _receiver.stream_out().eof() && _sender.stream_in().eof() && (bytes_in_flight()==0);
+    if(streams_finished && _linger_after_streams_finish)
+    {
+        const uint64_t linger = 10*_cfg.initial_rto_us();
+        const uint64_t since_last = time_since_last_segment_received_us();
+        const uint64_t linger_left = (linger > since_last) ? (linger - since_last) : 0;
+        deadline = min(deadline.value_or(linger_left), linger_left);
+    }
+    return deadline;
+}
+
+//! \details Keepalive runs while the connection is synchronized and not yet closed, and nothing else
+//! is outstanding (data in flight is covered by the retransmission timer). Probe `n` is due
+//! `keepalive_idle` plus `n` intervals after the last segment was received; the reset comes one
+//! interval after the last probe.
+optional<uint64_t> TCPConnection::keepalive_deadline_us() const
+{
+    //Once both streams have finished, the connection only waits for the owner to read the rest
+    const bool closed = _receiver.stream_out().input_ended() && _sender.stream_in().eof() && bytes_in_flight()==0;
+    if(_cfg.keepalive_idle == 0 || !active() || closed || !_sender.syn_acked() || !_receiver.ackno().has_value() || transfer_deadline_us().has_value())
+        return {};
+    const uint64_t due = (_cfg.keepalive_idle + uint64_t{_keepalive_probes_sent} * _cfg.keepalive_interval) * 1000;
+    const uint64_t since_last = time_since_last_segment_received_us();
+    return (due > since_last) ? (due - since_last) : 0;
+}
+
+void TCPConnection::keepalive()
+{
+    const optional<uint64_t> deadline = keepalive_deadline_us();
+    if(!deadline.has_value() || deadline.value() > 0)
+        return;
+    if(_keepalive_probes_sent < _cfg.keepalive_probes)
+    {
+        _sender.send_keepalive_probe();
+        _keepalive_probes_sent++;
+        return;
+    }
+    // the peer is gone: abort as after too many retransmissions
+    _send_rst = true;
+    use_rst_seqno = false;
+    _sender.stream_in().set_error();
+    inbound_stream().set_error();
+    _sender.send_empty_segment();
+}
+
 void TCPConnection::end_input_stream() 
 {
     _sender.stream_in().end_input();
@@ -115,12 +293,21 @@ void TCPConnection::connect()
     fill_queue();
 }
 
+size_t TCPConnection::connect(const string &data)
+{
+    const size_t write_size = _sender.stream_in().write(data);
+    connect();
+    return write_size;
+}
+
 //! Take segments from _sender's queue and push it to _segments_out{}
+//! \details Each segment's header is completed in the sender's ring and the segment is then moved
+//! across, so no payload is copied or reference-counted and no memory is allocated
 void TCPConnection::fill_queue()
 {
     while(!_sender.segments_out().empty())
     {
-        TCPSegment front_seg = _sender.segments_out().front();
+        TCPSegment &front_seg = _sender.segments_out().front();
         if(_sender.consecutive_retransmissions() > TCPConfig::MAX_RETX_ATTEMPTS)
         {
             _send_rst = true;  // _send_rst can be set in destructor also
@@ -133,15 +320,15 @@ void TCPConnection::fill_queue()
             front_seg.header().ack=1;
             front_seg.header().ackno = _receiver.ackno().value();
         }
-        front_seg.header().win = _receiver.window_size();
+        front_seg.header().win = min(_receiver.window_size(), static_cast<size_t>(numeric_limits<uint16_t>::max()));
         if(_send_rst)
         {
             front_seg.header().rst=1;
             if (use_rst_seqno)
                 front_seg.header().seqno = rst_seqno;
         }
+        _segments_out.push(move(front_seg));
         _sender.segments_out().pop();
-        _segments_out.push(front_seg);
     }
 }
 
@@ -6,26 +6,32 @@
 #include "tcp_sender.hh"
 #include "tcp_state.hh"
 
+#include <optional>
+#include <vector>
+
 //! \brief A complete endpoint of a TCP connection
 class TCPConnection {
   private:
     TCPConfig _cfg;
-    TCPReceiver _receiver{_cfg.recv_capacity};
-    TCPSender _sender{_cfg.send_capacity, _cfg.rt_timeout, _cfg.fixed_isn};
+    TCPReceiver _receiver{_cfg.recv_capacity, _cfg.recv_capacity_max, _cfg.accept_syn_data};
+    TCPSender _sender{_cfg};
 
     //! outbound queue of segments that the TCPConnection wants sent
-    std::queue<TCPSegment> _segments_out{};
+    RingQueue<TCPSegment> _segments_out{8};
 
     //! Should the TCPConnection stay active (and keep ACKing)
-    //! for 10 * _cfg.rt_timeout milliseconds after both streams have ended,
+    //! for 10 * the initial retransmission timeout after both streams have ended,
     //! in case the remote TCPConnection doesn't know we've received its whole stream?
     bool _linger_after_streams_finish{true};
 
-    //! time alive since TCP sender was started. Updated when tick() is called
-    size_t _time_connection_alive{0};
+    //! time alive since TCP sender was started, in microseconds. Updated when tick() is called
+    uint64_t _time_connection_alive{0};
 
     //! time when last segment was received
-    size_t _time_since_last_segment_received{0};
+    uint64_t _time_since_last_segment_received{0};
+
+    //! \brief Microseconds since the last segment was received
+    uint64_t time_since_last_segment_received_us() const { return _time_connection_alive - _time_since_last_segment_received; }
 
     //! rst flag seen in received segment
     bool _is_rst_seen{false};
@@ -41,10 +47,37 @@ class TCPConnection {
     
     //! modify sequence number for rst
     bool use_rst_seqno{false};
+
+    //! an acknowledged segment has opened the window; fill it once the received segments are processed
+    bool _fill_window_pending{false};
+
+    //! a received segment needs an ACK; send one once the received segments are processed
+    bool _ack_pending{false};
+
+    //! keepalive probes sent since the last segment was received
+    unsigned _keepalive_probes_sent{0};
+
+    //! Microseconds until the retransmission timer or the end of lingering, if either is running
+    std::optional<uint64_t> transfer_deadline_us() const;
+
+    //! Microseconds until the next keepalive probe (or the reset after the last one), if keepalive is running
+    std::optional<uint64_t> keepalive_deadline_us() const;
+
+    //! Send the keepalive probe that is due, or reset the connection if the peer has not answered any
+    void keepalive();
     
     //! Take segments from _sender's queue and push it to _segments_out{}
     void fill_queue();
 
+    //! Fast path for the expected in-order data segment or pure ACK
+    bool header_predicted(const TCPSegment &seg);
+
+    //! Process a received segment without generating any output
+    void receive(const TCPSegment &seg);
+
+    //! Generate the output called for by the segments received since the last call
+    void flush_received();
+
   public:
     //! \name "Input" interface for the writer
     //!@{
@@ -52,6 +85,11 @@ class TCPConnection {
     //! \brief Initiate a connection by sending a SYN segment
     void connect();
 
+    //! \brief Initiate a connection with `data` queued to send; with a Fast Open cookie
+    //! (TCPConfig::fastopen_cookie), the SYN carries as much of it as fits
+    //! \returns the number of bytes from `data` that were actually written
+    size_t connect(const std::string &data);
+
     //! \brief Write data to the outbound byte stream, and send it over TCP if possible
     //! \returns the number of bytes from `data` that were actually written.
     size_t write(const std::string &data);
@@ -59,6 +97,10 @@ class TCPConnection {
     //! \returns the number of `bytes` that can be written right now.
     size_t remaining_outbound_capacity() const;
 
+    //! \returns the number of `bytes` that can be written before the not-yet-sent backlog
+    //! reaches TCPConfig::notsent_lowat (never more than remaining_outbound_capacity())
+    size_t remaining_notsent_capacity() const;
+
     //! \brief Shut down the outbound byte stream (still allows reading incoming data)
     void end_input_stream();
     //!@}
@@ -79,6 +121,14 @@ class TCPConnection {
     size_t unassembled_bytes() const;
     //! \brief Number of milliseconds since the last segment was received
     size_t time_since_last_segment_received() const;
+    //! \brief sequence number of the next byte (or SYN/FIN) to be sent
+    WrappingInt32 next_seqno() const { return _sender.next_seqno(); }
+    //! \brief acknowledgment number sent to the peer, once its SYN has been received
+    std::optional<WrappingInt32> ackno() const { return _receiver.ackno(); }
+    //! \brief bytes of memory held by the connection: the object itself and its buffers and queues
+    size_t memory_usage() const;
+    //! \brief what the connection has learned about the path, e.g. for TCPMetricsCache
+    TCPMetrics metrics() const;
     //!< \brief summarize the state of the sender, receiver, and the connection
     TCPState state() const { return {_sender, _receiver, active(), _linger_after_streams_finish}; };
     //!@}
@@ -89,14 +139,44 @@ class TCPConnection {
     //! Called when a new segment has been received from the network
     void segment_received(const TCPSegment &seg);
 
+    //! Called with a burst of segments received from the network, in arrival order
+    void segments_received(const std::vector<TCPSegment> &segs);
+
     //! Called periodically when time elapses
-    void tick(const size_t ms_since_last_tick);
+    void tick(const size_t ms_since_last_tick) { tick_us(ms_since_last_tick * 1000); }
+
+    //! Called periodically when time elapses, with microsecond resolution
+    void tick_us(const uint64_t us_since_last_tick);
+
+    //! Milliseconds until tick() next has something to do (a retransmission, the end of lingering or
+    //! a keepalive probe), or empty if nothing will happen until a segment arrives or data is written
+    std::optional<size_t> next_deadline() const;
+
+    //! Microseconds until tick_us() next has something to do
+    std::optional<uint64_t> next_deadline_us() const;
+
+    //! \returns `true` if nothing is outstanding but keepalive probes, so the connection may stay idle for long
+    bool idle() const { return active() && !transfer_deadline_us().has_value(); }
+
+    //! Called when memory is tight; shrinks an auto-tuned receive buffer back to its initial size
+    void memory_pressure() { _receiver.memory_pressure(); }
+
+    //! Called when the connection goes idle; frees the storage of the queues that are empty
+    void shrink_to_fit();
+
+    //! \brief Called when the device below would block (`true`), so that no new data is sent, and
+    //! when it takes datagrams again (`false`), which fills the window
+    void set_output_blocked(const bool blocked);
+
+    //! \brief Called once the connection is in TIME_WAIT by an owner that keeps TIME_WAIT itself (as
+    //! TCPStack does); the connection stops lingering, so it is no longer active
+    void end_time_wait() { _linger_after_streams_finish = false; }
 
     //! \brief TCPSegments that the TCPConnection has enqueued for transmission.
     //! \note The owner or operating system will dequeue these and
     //! put each one into the payload of a lower-layer datagram (usually Internet datagrams (IP),
     //! but could also be user datagrams (UDP) or any other kind).
-    std::queue<TCPSegment> &segments_out() { return _segments_out; }
+    RingQueue<TCPSegment> &segments_out() { return _segments_out; }
 
     //! \brief Is the connection still alive in any way?
     //! \returns `true` if either stream is still running or if the TCPConnection is lingering
@@ -105,7 +185,7 @@ class TCPConnection {
     //!@}
 
     //! Construct a new connection from a configuration
-    explicit TCPConnection(const TCPConfig &cfg) : _cfg{cfg} {}
+    explicit TCPConnection(const TCPConfig &cfg);
 
     //! \name construction and destruction
     //! moving is allowed; copying is disallowed; default construction not possible
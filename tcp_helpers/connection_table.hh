@@ -0,0 +1,129 @@
+#ifndef SPONGE_LIBSPONGE_CONNECTION_TABLE_HH
+#define SPONGE_LIBSPONGE_CONNECTION_TABLE_HH
+
+#include "four_tuple.hh"
+
+#include <cstddef>
+#include <optional>
+#include <utility>
+#include <vector>
+
+//! \brief A flat, open-addressing hash table from FourTuple to `ValueT`
+//! \details Entries live in one array probed linearly from the tuple's hash, so a lookup touches
+//! one or two cache lines and needs no per-entry allocation. Erasing shifts the following entries
+//! of the probe run back (no tombstones), and the array doubles when it is 3/4 full.
+template <typename ValueT>
+class ConnectionTable {
+  private:
+    struct Slot {
+        FourTuple key{};
+        std::optional<ValueT> value{};  //!< empty if the slot is free
+    };
+
+    std::vector<Slot> _slots;
+    size_t _size{0};
+
+    size_t mask() const { return _slots.size() - 1; }
+
+    //! \returns the slot holding `key`, or else the free slot that ends its probe run
+    size_t probe(const FourTuple &key) const {
+        size_t i = key.hash() & mask();
+        while (_slots[i].value.has_value() and _slots[i].key != key) {
+            i = (i + 1) & mask();
+        }
+        return i;
+    }
+
+    void grow() {
+        std::vector<Slot> old = std::move(_slots);
+        _slots = std::vector<Slot>(old.size() * 2);
+        _size = 0;
+        for (auto &slot : old) {
+            if (slot.value.has_value()) {
+                insert(slot.key, std::move(slot.value.value()));
+            }
+        }
+    }
+
+  public:
+    //! \param[in] capacity the number of slots to start with (rounded up to a power of two)
+    explicit ConnectionTable(const size_t capacity = 64) : _slots() {
+        size_t slots = 8;
+        while (slots < capacity) {
+            slots *= 2;
+        }
+        _slots.resize(slots);
+    }
+
+    //! \returns the value for `key`, or nullptr
+    ValueT *find(const FourTuple &key) {
+        Slot &slot = _slots[probe(key)];
+        return slot.value.has_value() ? &slot.value.value() : nullptr;
+    }
+
+    //! \returns the value for `key`, or nullptr
+    const ValueT *find(const FourTuple &key) const {
+        const Slot &slot = _slots[probe(key)];
+        return slot.value.has_value() ? &slot.value.value() : nullptr;
+    }
+
+    //! \brief Insert or replace the value for `key`
+    //! \returns the stored value
+    ValueT &insert(const FourTuple &key, ValueT &&value) {
+        if (4 * (_size + 1) > 3 * _slots.size()) {
+            grow();
+        }
+        Slot &slot = _slots[probe(key)];
+        if (not slot.value.has_value()) {
+            _size++;
+        }
+        slot.key = key;
+        slot.value.emplace(std::move(value));
+        return slot.value.value();
+    }
+
+    //! \brief Remove the value for `key`, if any
+    //! \returns `true` if a value was removed
+    bool erase(const FourTuple &key) {
+        size_t hole = probe(key);
+        if (not _slots[hole].value.has_value()) {
+            return false;
+        }
+        _slots[hole].value.reset();
+        _size--;
+
+        // backward-shift deletion: move later members of the probe run into the hole
+        for (size_t i = (hole + 1) & mask(); _slots[i].value.has_value(); i = (i + 1) & mask()) {
+            const size_t home = _slots[i].key.hash() & mask();
+            // the entry may move to `hole` unless its home lies cyclically in (hole, i]
+            const bool home_after_hole = (i > hole) ? (home > hole and home <= i) : (home > hole or home <= i);
+            if (home_after_hole) {
+                continue;
+            }
+            _slots[hole].key = _slots[i].key;
+            _slots[hole].value.emplace(std::move(_slots[i].value.value()));
+            _slots[i].value.reset();
+            hole = i;
+        }
+        return true;
+    }
+
+    //! \returns the number of entries
+    size_t size() const { return _size; }
+
+    //! \returns `true` if the table has no entries
+    bool empty() const { return _size == 0; }
+
+    //! \brief Call `f(key, value)` for every entry
+    //! \note `f` must not insert into or erase from the table
+    template <typename F>
+    void for_each(F &&f) {
+        for (auto &slot : _slots) {
+            if (slot.value.has_value()) {
+                f(slot.key, slot.value.value());
+            }
+        }
+    }
+};
+
+#endif  // SPONGE_LIBSPONGE_CONNECTION_TABLE_HH
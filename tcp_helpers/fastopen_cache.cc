@@ -0,0 +1,33 @@
+#include "fastopen_cache.hh"
+
+using namespace std;
+
+FastOpenCache &FastOpenCache::global() {
+    static FastOpenCache cache;
+    return cache;
+}
+
+optional<string> FastOpenCache::find(const uint32_t server_ip) const {
+    lock_guard<mutex> lock(_mutex);
+    const auto it = _cookies.find(server_ip);
+    if (it == _cookies.end()) {
+        return {};
+    }
+    return it->second;
+}
+
+void FastOpenCache::insert(const uint32_t server_ip, const string &cookie) {
+    lock_guard<mutex> lock(_mutex);
+    if (_capacity == 0) {
+        return;
+    }
+    if (_cookies.size() >= _capacity and _cookies.find(server_ip) == _cookies.end()) {
+        _cookies.erase(_cookies.begin());
+    }
+    _cookies[server_ip] = cookie;
+}
+
+void FastOpenCache::erase(const uint32_t server_ip) {
+    lock_guard<mutex> lock(_mutex);
+    _cookies.erase(server_ip);
+}
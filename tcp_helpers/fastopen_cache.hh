@@ -0,0 +1,39 @@
+#ifndef SPONGE_LIBSPONGE_FASTOPEN_CACHE_HH
+#define SPONGE_LIBSPONGE_FASTOPEN_CACHE_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+//! \brief The client side of [TCP Fast Open](https://tools.ietf.org/html/rfc7413): the cookies
+//! that servers have issued, by server address
+//! \details A cookie is learned from the Fast Open option of a SYN/ACK, and lets later SYNs to the
+//! same server carry data. The cache is bounded; when it is full, an arbitrary entry is evicted.
+//! It may be shared by connections running on different threads.
+class FastOpenCache {
+  private:
+    mutable std::mutex _mutex{};
+    std::unordered_map<uint32_t, std::string> _cookies{};
+    size_t _capacity;
+
+  public:
+    //! \param[in] capacity the most servers to remember cookies for
+    explicit FastOpenCache(const size_t capacity = 1024) : _capacity(capacity) {}
+
+    //! \returns the cache shared by the whole process
+    static FastOpenCache &global();
+
+    //! \returns the cookie issued by the server at `server_ip`, if any
+    std::optional<std::string> find(const uint32_t server_ip) const;
+
+    //! Remember (or replace) the cookie issued by the server at `server_ip`
+    void insert(const uint32_t server_ip, const std::string &cookie);
+
+    //! Forget the cookie of the server at `server_ip`, e.g. after it has refused SYN data
+    void erase(const uint32_t server_ip);
+};
+
+#endif  // SPONGE_LIBSPONGE_FASTOPEN_CACHE_HH
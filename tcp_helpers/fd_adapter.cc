@@ -6,8 +6,7 @@
 
 using namespace std;
 
-//! \details This function first attempts to parse a TCP segment from the next UDP
-//! payload recv()d from the socket.
+//! \details This function attempts to parse a TCP segment from a UDP payload recv()d from the socket.
 //!
 //! If this succeeds, it then checks that the received segment is related to the
 //! current connection. When a TCP connection has been established, this means
@@ -18,9 +17,7 @@ using namespace std;
 //! `_listen` flag and calls calls connect() on the underlying UDP socket, with
 //! the result that future outgoing segments go to the sender of the SYN segment.
 //! \returns a std::optional<TCPSegment> that is empty if the segment was invalid or unrelated
-optional<TCPSegment> TCPOverUDPSocketAdapter::read() {
-    auto datagram = _sock.recv();
-
+optional<TCPSegment> TCPOverUDPSocketAdapter::unwrap_tcp_in_udp(UDPSocket::received_datagram &datagram) {
     // is it for us?
     if (not listening() and (datagram.source_address != config().destination)) {
         return {};
@@ -45,12 +42,63 @@ optional<TCPSegment> TCPOverUDPSocketAdapter::read() {
     return seg;
 }
 
+//! \returns a std::optional<TCPSegment> that is empty if the segment was invalid or unrelated
+optional<TCPSegment> TCPOverUDPSocketAdapter::read() {
+    auto datagram = _sock.recv();
+    return unwrap_tcp_in_udp(datagram);
+}
+
+//! \param[out] segments receives the TCP segments, in arrival order
+//! \details Stops when the socket has no datagram waiting, or after MAX_READ_BATCH datagrams.
+void TCPOverUDPSocketAdapter::read_batch(vector<TCPSegment> &segments) {
+    UDPSocket::received_datagram datagram{{nullptr, 0}, ""};
+    for (size_t i = 0; i < MAX_READ_BATCH and _sock.try_recv(datagram); i++) {
+        auto seg = unwrap_tcp_in_udp(datagram);
+        if (seg) {
+            segments.push_back(move(seg.value()));
+        }
+    }
+}
+
 //! Serialize a TCP segment and send it as the payload of a UDP datagram.
+//! A super-segment (see TCPSegment::gso_size) is split here and sent as one batch of datagrams.
+//! While earlier payloads are queued, new ones are queued behind them, so none is sent out of order;
+//! those that do not fit in the queue (MAX_UNSENT) are dropped.
 //! \param[in] seg is the TCP segment to write
-void TCPOverUDPSocketAdapter::write(TCPSegment &seg) {
+bool TCPOverUDPSocketAdapter::write(TCPSegment &seg) {
+    if (_unsent.size() >= MAX_UNSENT) {
+        return false;
+    }
     seg.header().sport = config().source.port();
     seg.header().dport = config().destination.port();
-    _sock.sendto(config().destination, seg.serialize(0));
+    if (seg.gso_size() == 0) {
+        BufferList payload = seg.serialize(0);
+        if (_unsent.empty() and _sock.try_sendto(config().destination, payload)) {
+            return true;
+        }
+        _unsent.push(move(payload));
+        return false;
+    }
+
+    vector<BufferList> datagrams;
+    for (const auto &piece : seg.gso_split()) {
+        datagrams.push_back(piece.serialize(0));
+    }
+    const size_t sent = _unsent.empty() ? _sock.try_sendto_batch(config().destination, datagrams) : 0;
+    for (size_t i = sent; i < datagrams.size() and _unsent.size() < MAX_UNSENT; i++) {
+        _unsent.push(move(datagrams[i]));
+    }
+    return sent == datagrams.size();
+}
+
+bool TCPOverUDPSocketAdapter::flush() {
+    while (not _unsent.empty()) {
+        if (not _sock.try_sendto(config().destination, _unsent.front())) {
+            return false;
+        }
+        _unsent.pop();
+    }
+    return true;
 }
 
 //! Specialize LossyFdAdapter to TCPOverUDPSocketAdapter
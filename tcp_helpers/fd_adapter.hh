@@ -3,6 +3,7 @@
 
 #include "file_descriptor.hh"
 #include "lossy_fd_adapter.hh"
+#include "ring_queue.hh"
 #include "socket.hh"
 #include "tcp_config.hh"
 #include "tcp_header.hh"
@@ -10,9 +11,15 @@
 
 #include <optional>
 #include <utility>
+#include <vector>
 
 //! \brief Basic functionality for file descriptor adaptors
 //! \details See TCPOverUDPSocketAdapter and TCPOverIPv4OverTunFdAdapter for more information.
+//!
+//! An adapter's write() never blocks: what the fd would not take is queued in the adapter (up to
+//! MAX_UNSENT datagrams; beyond that they are dropped, as by a full device queue, for TCP to
+//! retransmit), and write() returns `false`. The owner then waits for the fd to be writable,
+//! calls flush(), and holds back further output while write_blocked().
 class FdAdapterBase {
   private:
     FdAdapterConfig _cfg{};  //!< Configuration values
@@ -40,6 +47,21 @@ class FdAdapterBase {
 
     //! Called periodically when time elapses
     void tick(const size_t) {}
+
+    //! Called periodically when time elapses, with microsecond resolution
+    void tick_us(const uint64_t) {}
+
+    //! Milliseconds until tick() next has something to do (never, for a plain fd)
+    std::optional<size_t> next_deadline() const { return {}; }
+
+    //! Microseconds until tick_us() next has something to do (never, for a plain fd)
+    std::optional<uint64_t> next_deadline_us() const { return {}; }
+
+    //! Most datagrams taken from the fd by one call to read_batch()
+    static constexpr size_t MAX_READ_BATCH = 64;
+
+    //! Most datagrams queued while the fd would block (one super-segment's worth)
+    static constexpr size_t MAX_UNSENT = 64;
 };
 
 //! \brief A FD adaptor that reads and writes TCP segments in UDP payloads
@@ -47,6 +69,12 @@ class TCPOverUDPSocketAdapter : public FdAdapterBase {
   private:
     UDPSocket _sock;
 
+    //! UDP payloads that the socket's send buffer had no room for, oldest first
+    RingQueue<BufferList> _unsent{};
+
+    //! Checks that a received datagram belongs to the connection and parses its TCP segment
+    std::optional<TCPSegment> unwrap_tcp_in_udp(UDPSocket::received_datagram &datagram);
+
   public:
     //! Construct from a UDPSocket sliced into a FileDescriptor
     explicit TCPOverUDPSocketAdapter(UDPSocket &&sock) : _sock(std::move(sock)) {}
@@ -54,8 +82,20 @@ class TCPOverUDPSocketAdapter : public FdAdapterBase {
     //! Attempts to read and return a TCP segment related to the current connection from a UDP payload
     std::optional<TCPSegment> read();
 
-    //! Writes a TCP segment into a UDP payload
-    void write(TCPSegment &seg);
+    //! Reads the datagrams already waiting on the socket, appending the related TCP segments to `segments`
+    void read_batch(std::vector<TCPSegment> &segments);
+
+    //! Writes a TCP segment into a UDP payload (or, for a super-segment, a batch of them)
+    //! \returns `false` if the socket would block, leaving (some of) the segment queued or, once the
+    //! queue is full, dropped
+    bool write(TCPSegment &seg);
+
+    //! Sends the queued payloads, while the socket takes them
+    //! \returns `true` if none is left
+    bool flush();
+
+    //! \returns `true` if payloads are queued, waiting for the socket to be writable
+    bool write_blocked() const { return not _unsent.empty(); }
 
     //! Access the underlying UDP socket
     operator UDPSocket &() { return _sock; }
@@ -0,0 +1,29 @@
+#ifndef SPONGE_LIBSPONGE_FOUR_TUPLE_HH
+#define SPONGE_LIBSPONGE_FOUR_TUPLE_HH
+
+#include <cstdint>
+
+//! \brief The (local address, local port, remote address, remote port) that identifies a TCP connection
+struct FourTuple {
+    uint32_t local_ip{0};      //!< local IPv4 address, in host byte order
+    uint16_t local_port{0};    //!< local port
+    uint32_t remote_ip{0};     //!< remote IPv4 address, in host byte order
+    uint16_t remote_port{0};   //!< remote port
+
+    bool operator==(const FourTuple &other) const {
+        return local_ip == other.local_ip and local_port == other.local_port and remote_ip == other.remote_ip and
+               remote_port == other.remote_port;
+    }
+    bool operator!=(const FourTuple &other) const { return not operator==(other); }
+
+    //! \returns a well-mixed 64-bit hash of the tuple
+    uint64_t hash() const {
+        uint64_t x = (uint64_t{local_ip} << 32 | remote_ip) ^ (uint64_t{local_port} << 16 | remote_port) * 0x9e3779b97f4a7c15;
+        // splitmix64 finalizer
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+        return x ^ (x >> 31);
+    }
+};
+
+#endif  // SPONGE_LIBSPONGE_FOUR_TUPLE_HH
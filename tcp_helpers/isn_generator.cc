@@ -0,0 +1,26 @@
+#include "isn_generator.hh"
+
+#include "util.hh"
+
+#include <array>
+
+using namespace std;
+
+ISNGenerator &ISNGenerator::global() {
+    static ISNGenerator generator;
+    return generator;
+}
+
+WrappingInt32 ISNGenerator::isn(const FourTuple &tuple) {
+    const array<uint32_t, 3> words{
+        tuple.local_ip, tuple.remote_ip, uint32_t{tuple.local_port} << 16 | tuple.remote_port};
+    const uint64_t m = timestamp_us() / 4;
+    return WrappingInt32{static_cast<uint32_t>(m + _hash(words.data(), sizeof(words)))};
+}
+
+WrappingInt32 ISNGenerator::isn() { return WrappingInt32{random32()}; }
+
+uint32_t ISNGenerator::random32() {
+    const uint64_t count = _counter.fetch_add(1, memory_order_relaxed);
+    return static_cast<uint32_t>(_hash(&count, sizeof(count)));
+}
@@ -0,0 +1,39 @@
+#ifndef SPONGE_LIBSPONGE_ISN_GENERATOR_HH
+#define SPONGE_LIBSPONGE_ISN_GENERATOR_HH
+
+#include "four_tuple.hh"
+#include "siphash.hh"
+#include "wrapping_integers.hh"
+
+#include <atomic>
+#include <cstdint>
+
+//! \brief Initial sequence numbers chosen as [RFC 6528](https://tools.ietf.org/html/rfc6528) recommends
+//! \details ISN = M + F(4-tuple, secret key), where M is a clock that ticks every 4 microseconds
+//! and F is SipHash under a key drawn once per process. Successive connections with the same
+//! tuple get increasing ISNs (so old duplicates are not mistaken for new data), while an off-path
+//! attacker cannot predict the ISN of any tuple. Generating one costs a hash and a clock read
+//! (a vDSO call), not a `getrandom` system call.
+class ISNGenerator {
+  private:
+    SipHash _hash;
+    std::atomic<uint64_t> _counter{0};  //!< stands in for the tuple when it is not known
+
+  public:
+    //! Generator with a key drawn from the system's random device
+    ISNGenerator() : _hash(SipHash::with_random_key()) {}
+
+    //! \returns the process-wide generator
+    static ISNGenerator &global();
+
+    //! \returns the ISN for a connection identified by `tuple`
+    WrappingInt32 isn(const FourTuple &tuple);
+
+    //! \returns an unpredictable ISN for a connection whose tuple is not known
+    WrappingInt32 isn();
+
+    //! \returns an unpredictable 32-bit value, e.g. for a source port, without a system call
+    uint32_t random32();
+};
+
+#endif  // SPONGE_LIBSPONGE_ISN_GENERATOR_HH
@@ -9,6 +9,7 @@
 #include <optional>
 #include <random>
 #include <utility>
+#include <vector>
 
 //! An adapter class that adds random dropping behavior to an FD adapter
 template <typename AdapterT>
@@ -47,11 +48,38 @@ class LossyFdAdapter {
         return ret;
     }
 
+    //! \brief Read a batch from the underlying AdapterT instance, potentially dropping each segment read
+    //! \param[out] segments receives the segments that were not dropped
+    void read_batch(std::vector<TCPSegment> &segments) {
+        const size_t first = segments.size();
+        _adapter.read_batch(segments);
+        auto kept = segments.begin() + first;
+        for (auto it = kept; it != segments.end(); it++) {
+            if (_should_drop(false)) {
+                continue;
+            }
+            if (kept != it) {
+                *kept = std::move(*it);
+            }
+            kept++;
+        }
+        segments.erase(kept, segments.end());
+    }
+
     //! \brief Write to the underlying AdapterT instance, potentially dropping the datagram to be written
     //! \param[in] seg is the packet to either write or drop
-    void write(TCPSegment &seg) {
+    //! \returns `false` if the underlying AdapterT would block (see FdAdapterBase)
+    //! \note A super-segment is split first, so that each wire segment is dropped independently
+    bool write(TCPSegment &seg) {
+        if (seg.gso_size() != 0) {
+            bool sent = true;
+            for (auto &piece : seg.gso_split()) {
+                sent = write(piece) and sent;
+            }
+            return sent;
+        }
         if (_should_drop(true)) {
-            return;
+            return true;
         }
         return _adapter.write(seg);
     }
@@ -63,9 +91,20 @@ class LossyFdAdapter {
     void set_listening(const bool l) { _adapter.set_listening(l); }      //!< FdAdapterBase::set_listening passthrough
     const FdAdapterConfig &config() const { return _adapter.config(); }  //!< FdAdapterBase::config passthrough
     FdAdapterConfig &config_mut() { return _adapter.config_mut(); }      //!< FdAdapterBase::config_mut passthrough
+    bool flush() { return _adapter.flush(); }                            //!< AdapterT::flush passthrough
+    bool write_blocked() const { return _adapter.write_blocked(); }      //!< AdapterT::write_blocked passthrough
     void tick(const size_t ms_since_last_tick) {
         _adapter.tick(ms_since_last_tick);
     }  //!< FdAdapterBase::tick passthrough
+    void tick_us(const uint64_t us_since_last_tick) {
+        _adapter.tick_us(us_since_last_tick);
+    }  //!< FdAdapterBase::tick_us passthrough
+    std::optional<size_t> next_deadline() const {
+        return _adapter.next_deadline();
+    }  //!< FdAdapterBase::next_deadline passthrough
+    std::optional<uint64_t> next_deadline_us() const {
+        return _adapter.next_deadline_us();
+    }  //!< FdAdapterBase::next_deadline_us passthrough
     //!@}
 };
 
@@ -0,0 +1,11 @@
+#include "port_allocator.hh"
+
+#include <stdexcept>
+
+using namespace std;
+
+PortAllocator::PortAllocator(const uint16_t first, const uint16_t last) : _first(first), _count(last - first + 1) {
+    if (first == 0 or last < first) {
+        throw runtime_error("PortAllocator: invalid port range");
+    }
+}
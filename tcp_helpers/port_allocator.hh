@@ -0,0 +1,67 @@
+#ifndef SPONGE_LIBSPONGE_PORT_ALLOCATOR_HH
+#define SPONGE_LIBSPONGE_PORT_ALLOCATOR_HH
+
+#include "four_tuple.hh"
+#include "siphash.hh"
+
+#include <array>
+#include <cstdint>
+#include <optional>
+
+//! \brief Chooses ephemeral source ports with the double-hash algorithm of
+//! [RFC 6056](https://tools.ietf.org/html/rfc6056), section 3.3.4
+//! \details The search for a port to (local address, remote address, remote port) starts at a
+//! keyed-hash offset, plus a counter shared by the destinations that hash to the same entry of
+//! a small table. Successive connections to one destination therefore get successive ports
+//! (so a port is not reused until the whole range has been), while the ports used towards one
+//! destination reveal nothing about those used towards another.
+class PortAllocator {
+  public:
+    static constexpr uint16_t FIRST_EPHEMERAL = 49152;  //!< Start of the IANA ephemeral range
+    static constexpr uint16_t LAST_EPHEMERAL = 65535;   //!< End of the IANA ephemeral range
+    static constexpr size_t TABLE_LENGTH = 1024;        //!< Number of per-destination counters
+
+  private:
+    SipHash _hash{SipHash::with_random_key()};
+    std::array<uint32_t, TABLE_LENGTH> _table{};
+    uint16_t _first;
+    uint32_t _count;
+
+  public:
+    //! \param[in] first the lowest port to allocate
+    //! \param[in] last the highest port to allocate
+    explicit PortAllocator(const uint16_t first = FIRST_EPHEMERAL, const uint16_t last = LAST_EPHEMERAL);
+
+    //! \brief Choose a local port for a connection from `local_ip` to `remote_ip`:`remote_port`
+    //! \param[in] usable is called with each candidate tuple and returns `true` if it may be used
+    //! (e.g. if it is not in a connection table); it should take O(1) time
+    //! \returns the tuple of the first usable port tried, or nothing if no port in the range is usable
+    template <typename UsableT>
+    std::optional<FourTuple> allocate(const uint32_t local_ip,
+                                      const uint32_t remote_ip,
+                                      const uint16_t remote_port,
+                                      UsableT &&usable);
+};
+
+template <typename UsableT>
+std::optional<FourTuple> PortAllocator::allocate(const uint32_t local_ip,
+                                                 const uint32_t remote_ip,
+                                                 const uint16_t remote_port,
+                                                 UsableT &&usable) {
+    const std::array<uint32_t, 3> words{local_ip, remote_ip, remote_port};
+    const uint64_t h = _hash(words.data(), sizeof(words));
+    // the two halves of the keyed hash serve as RFC 6056's independent F() and G()
+    const uint32_t offset = static_cast<uint32_t>(h);
+    uint32_t &counter = _table[(h >> 32) % TABLE_LENGTH];
+
+    for (uint32_t tries = 0; tries < _count; tries++) {
+        const FourTuple tuple{local_ip, static_cast<uint16_t>(_first + (uint64_t{offset} + counter) % _count), remote_ip, remote_port};
+        counter++;
+        if (usable(tuple)) {
+            return tuple;
+        }
+    }
+    return {};
+}
+
+#endif  // SPONGE_LIBSPONGE_PORT_ALLOCATOR_HH
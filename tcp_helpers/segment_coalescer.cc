@@ -0,0 +1,66 @@
+#include "segment_coalescer.hh"
+
+#include <utility>
+
+using namespace std;
+
+//! \param[in] seg is the segment that arrived after the pending run
+bool SegmentCoalescer::can_merge(const TCPSegment &seg) const {
+    const TCPHeader &run = _pending->header();
+    const TCPHeader &next = seg.header();
+
+    // only plain data and ACK segments, and nothing after a FIN
+    if (run.syn or run.rst or run.urg or run.fin or not run.ack) {
+        return false;
+    }
+    if (next.syn or next.rst or next.urg or not next.ack or next.sport != run.sport or next.dport != run.dport) {
+        return false;
+    }
+
+    // contiguous in sequence space, with an ackno that doesn't move backwards
+    const size_t run_payload_size = _pending_payload ? _pending_payload->size() : _pending->payload().size();
+    if (next.seqno != run.seqno + run_payload_size or next.ackno - run.ackno < 0) {
+        return false;
+    }
+
+    return run_payload_size + seg.payload().size() <= MAX_COALESCED_PAYLOAD;
+}
+
+//! \param[in] seg is the next segment read from the wire
+void SegmentCoalescer::push(TCPSegment &&seg) {
+    if (not _pending) {
+        _pending = move(seg);
+        return;
+    }
+
+    if (not can_merge(seg)) {
+        flush();
+        _pending = move(seg);
+        return;
+    }
+
+    if (not _pending_payload) {
+        _pending_payload = _pending->payload().copy();
+    }
+    _pending_payload->append(seg.payload().str());
+
+    // the newest segment supplies the ackno, window and flags; the run keeps its starting seqno
+    TCPHeader &run = _pending->header();
+    const WrappingInt32 seqno = run.seqno;
+    const bool psh = run.psh;
+    run = seg.header();
+    run.seqno = seqno;
+    run.psh |= psh;
+}
+
+void SegmentCoalescer::flush() {
+    if (not _pending) {
+        return;
+    }
+    if (_pending_payload) {
+        _pending->payload() = Buffer(move(_pending_payload.value()));
+        _pending_payload.reset();
+    }
+    _segments_out.push(move(_pending.value()));
+    _pending.reset();
+}
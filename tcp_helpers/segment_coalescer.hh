@@ -0,0 +1,46 @@
+#ifndef SPONGE_LIBSPONGE_SEGMENT_COALESCER_HH
+#define SPONGE_LIBSPONGE_SEGMENT_COALESCER_HH
+
+#include "tcp_segment.hh"
+
+#include <optional>
+#include <queue>
+#include <string>
+
+//! \brief Receive-side segment coalescing (in the spirit of Linux's GRO)
+
+//! Segments read in one burst are pushed in arrival order. Runs of plain in-sequence
+//! segments (ACK and optionally PSH set, the last one possibly with FIN) are merged into a
+//! single segment that carries the concatenated payload and the newest ackno and window,
+//! so that TCPConnection::segment_received runs once per run instead of once per segment.
+//! Anything else (SYN, RST, URG, gaps, duplicates, stale ACKs) ends the run and is passed
+//! through unchanged.
+class SegmentCoalescer {
+  private:
+    //! coalesced segments, in order
+    std::queue<TCPSegment> _segments_out{};
+
+    //! the run being merged
+    std::optional<TCPSegment> _pending{};
+
+    //! payload of the run, once a second segment has been merged into it
+    std::optional<std::string> _pending_payload{};
+
+    //! \returns `true` if `seg` can be appended to the pending run
+    bool can_merge(const TCPSegment &seg) const;
+
+  public:
+    //! \brief Largest payload of a coalesced segment
+    static constexpr size_t MAX_COALESCED_PAYLOAD = 65536;
+
+    //! \brief Add the next segment of the burst
+    void push(TCPSegment &&seg);
+
+    //! \brief End the burst: the pending run is moved to segments_out()
+    void flush();
+
+    //! \brief Coalesced segments ready for TCPConnection::segment_received
+    std::queue<TCPSegment> &segments_out() { return _segments_out; }
+};
+
+#endif  // SPONGE_LIBSPONGE_SEGMENT_COALESCER_HH
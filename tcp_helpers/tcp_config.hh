@@ -2,24 +2,60 @@
 #define SPONGE_LIBSPONGE_TCP_CONFIG_HH
 
 #include "address.hh"
+#include "tcp_metrics.hh"
 #include "wrapping_integers.hh"
 
 #include <cstddef>
 #include <cstdint>
+#include <limits>
 #include <optional>
+#include <string>
 
 //! Config for TCP sender and receiver
 class TCPConfig {
   public:
     static constexpr size_t DEFAULT_CAPACITY = 64000;  //!< Default capacity
     static constexpr size_t MAX_PAYLOAD_SIZE = 1452;   //!< Max TCP payload that fits in either IPv4 or UDP datagram
+    static constexpr size_t GSO_MAX_PAYLOAD_SIZE = 65536;  //!< Max payload of a super-segment split by the adapter
     static constexpr uint16_t TIMEOUT_DFLT = 1000;     //!< Default re-transmit timeout is 1 second
     static constexpr unsigned MAX_RETX_ATTEMPTS = 8;   //!< Maximum re-transmit attempts before giving up
+    static constexpr size_t SEND_BUFFER_WINDOWS = 2;   //!< Auto-sized send buffer holds this many peer windows
+    static constexpr uint32_t MIN_RTO_US = 200000;     //!< Least RTO computed from cached metrics (as Linux's TCP_RTO_MIN)
 
     uint16_t rt_timeout = TIMEOUT_DFLT;       //!< Initial value of the retransmission timeout, in milliseconds
+    //! Initial value of the retransmission timeout in microseconds, for sub-millisecond RTOs; overrides rt_timeout if nonzero
+    uint32_t rt_timeout_us = 0;
     size_t recv_capacity = DEFAULT_CAPACITY;  //!< Receive capacity, in bytes
+    //! Upper bound for receive-buffer auto-tuning, in bytes (no auto-tuning if not above recv_capacity)
+    //! \note Without window scaling the advertised window is limited to 65535 bytes
+    size_t recv_capacity_max = DEFAULT_CAPACITY;
     size_t send_capacity = DEFAULT_CAPACITY;  //!< Sender capacity, in bytes
+    //! Upper bound for send-buffer auto-sizing, in bytes (no auto-sizing if not above send_capacity)
+    size_t send_capacity_max = DEFAULT_CAPACITY;
+    //! Most unsent bytes the owner may queue in the outbound stream (like TCP_NOTSENT_LOWAT)
+    size_t notsent_lowat = std::numeric_limits<size_t>::max();
     std::optional<WrappingInt32> fixed_isn{};
+    bool gso = false;  //!< Emit super-segments for the adapter to split into MAX_PAYLOAD_SIZE segments
+    bool gro = false;  //!< Coalesce the in-sequence segments of each read burst before processing them
+    //! Idle time before the first keepalive probe, in milliseconds (no keepalive if zero)
+    uint32_t keepalive_idle = 0;
+    uint32_t keepalive_interval = 75000;  //!< Time between unanswered keepalive probes, in milliseconds
+    unsigned keepalive_probes = 9;        //!< Unanswered keepalive probes after which the connection is reset
+    //! Use [TCP Fast Open](https://tools.ietf.org/html/rfc7413): TCPStack and TCPSpongeSocket fill in
+    //! `fastopen_cookie` from FastOpenCache for connections they open, and issue cookies as servers
+    bool fastopen = false;
+    //! Fast Open option for the SYN: a cookie, which lets the SYN carry data, or if empty a cookie request
+    std::optional<std::string> fastopen_cookie{};
+    //! Take the data on the peer's SYN; set only by a server that has validated the SYN's Fast Open
+    //! cookie (TCPStack does), since otherwise the data is unauthenticated (RFC 7413, section 4.2.2)
+    bool accept_syn_data = false;
+    //! TCPStack and TCPSpongeSocket warm-start connections from TCPMetricsCache, and save their metrics to it
+    bool use_metrics_cache = false;
+    //! Path metrics to start from: RTT estimates (which may lower the initial RTO to MIN_RTO_US) and buffer sizes
+    std::optional<TCPMetrics> metrics{};
+
+    //! The initial retransmission timeout in microseconds (rt_timeout_us, or else rt_timeout)
+    uint64_t initial_rto_us() const { return rt_timeout_us ? rt_timeout_us : rt_timeout * uint64_t{1000}; }
 };
 
 //! Config for classes derived from FdAdapter
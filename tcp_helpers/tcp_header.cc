@@ -1,5 +1,6 @@
 #include "tcp_header.hh"
 
+#include <algorithm>
 #include <sstream>
 
 using namespace std;
@@ -37,8 +38,34 @@ ParseResult TCPHeader::parse(NetParser &p) {
         return ParseResult::HeaderTooShort;
     }
 
-    // skip any options or anything extra in the header
-    p.remove_prefix(doff * 4 - TCPHeader::LENGTH);
+    // options: keep Fast Open, skip the rest and anything after the end of the list
+    fastopen = false;
+    fastopen_cookie.clear();
+    size_t options_left = doff * 4 - TCPHeader::LENGTH;
+    while (options_left > 0 and not p.error()) {
+        const uint8_t kind = p.u8();
+        options_left--;
+        if (kind == OPTION_END) {
+            break;
+        }
+        if (kind == OPTION_NOP) {
+            continue;
+        }
+        const size_t len = options_left > 0 ? p.u8() : 0;
+        if (len < 2 or len - 1 > options_left) {
+            return ParseResult::TruncatedPacket;
+        }
+        options_left -= len - 1;
+        if (kind == OPTION_FASTOPEN and len - 2 <= FASTOPEN_COOKIE_MAX) {
+            fastopen = true;
+            for (size_t i = 2; i < len; i++) {
+                fastopen_cookie.push_back(static_cast<char>(p.u8()));
+            }
+        } else {
+            p.remove_prefix(len - 2);
+        }
+    }
+    p.remove_prefix(options_left);
 
     if (p.error()) {
         return p.get_error();
@@ -47,21 +74,30 @@ ParseResult TCPHeader::parse(NetParser &p) {
     return ParseResult::NoError;
 }
 
+size_t TCPHeader::length() const {
+    const size_t options = fastopen ? 2 + fastopen_cookie.size() : 0;
+    return max(4 * size_t{doff}, LENGTH + (options + 3) / 4 * 4);
+}
+
 //! Serialize the TCPHeader to a string (does not recompute the checksum)
 string TCPHeader::serialize() const {
     // sanity check
     if (doff < 5) {
         throw runtime_error("TCP header too short");
     }
+    if (fastopen_cookie.size() > FASTOPEN_COOKIE_MAX) {
+        throw runtime_error("TCP Fast Open cookie too long");
+    }
 
+    const size_t header_length = length();
     string ret;
-    ret.reserve(4 * doff);
+    ret.reserve(header_length);
 
     NetUnparser::u16(ret, sport);              // source port
     NetUnparser::u16(ret, dport);              // destination port
     NetUnparser::u32(ret, seqno.raw_value());  // sequence number
     NetUnparser::u32(ret, ackno.raw_value());  // ack number
-    NetUnparser::u8(ret, doff << 4);           // data offset
+    NetUnparser::u8(ret, header_length / 4 << 4);  // data offset
 
     const uint8_t fl_b = (urg ? 0b0010'0000 : 0) | (ack ? 0b0001'0000 : 0) | (psh ? 0b0000'1000 : 0) |
                          (rst ? 0b0000'0100 : 0) | (syn ? 0b0000'0010 : 0) | (fin ? 0b0000'0001 : 0);
@@ -72,7 +108,13 @@ string TCPHeader::serialize() const {
 
     NetUnparser::u16(ret, uptr);  // urgent pointer
 
-    ret.resize(4 * doff);  // expand header to advertised size
+    if (fastopen) {
+        NetUnparser::u8(ret, OPTION_FASTOPEN);
+        NetUnparser::u8(ret, 2 + fastopen_cookie.size());
+        ret.append(fastopen_cookie);
+    }
+
+    ret.resize(header_length);  // expand header to advertised size (padding with OPTION_END)
 
     return ret;
 }
@@ -89,7 +131,8 @@ string TCPHeader::to_string() const {
        << " fin: " << fin << '\n'
        << "TCP winsize: " << +win << '\n'
        << "TCP cksum: " << +cksum << '\n'
-       << "TCP uptr: " << +uptr << '\n';
+       << "TCP uptr: " << +uptr << '\n'
+       << "TCP Fast Open: " << fastopen << " (cookie of " << dec << fastopen_cookie.size() << " bytes)\n";
     return ss.str();
 }
 
@@ -104,5 +147,5 @@ bool TCPHeader::operator==(const TCPHeader &other) const {
     // TODO(aozdemir) more complete check (right now we omit cksum, src, dst
     return seqno == other.seqno && ackno == other.ackno && doff == other.doff && urg == other.urg && ack == other.ack &&
            psh == other.psh && rst == other.rst && syn == other.syn && fin == other.fin && win == other.win &&
-           uptr == other.uptr;
+           uptr == other.uptr && fastopen == other.fastopen && fastopen_cookie == other.fastopen_cookie;
 }
@@ -4,11 +4,23 @@
 #include "parser.hh"
 #include "wrapping_integers.hh"
 
+#include <string>
+
 //! \brief [TCP](\ref rfc::rfc793) segment header
-//! \note TCP options are not supported
+//! \note The only TCP option supported is Fast Open; others are skipped when parsing
 struct TCPHeader {
     static constexpr size_t LENGTH = 20;  //!< [TCP](\ref rfc::rfc793) header length, not including options
 
+    //! \name TCP option kinds
+    //!@{
+    static constexpr uint8_t OPTION_END = 0;        //!< end of option list
+    static constexpr uint8_t OPTION_NOP = 1;        //!< no-operation (padding)
+    static constexpr uint8_t OPTION_FASTOPEN = 34;  //!< [TCP Fast Open](https://tools.ietf.org/html/rfc7413) cookie
+    //!@}
+
+    //! Longest Fast Open cookie (RFC 7413, section 4.1.1)
+    static constexpr size_t FASTOPEN_COOKIE_MAX = 16;
+
     //! \struct TCPHeader
     //! ~~~{.txt}
     //!   0                   1                   2                   3
@@ -50,6 +62,15 @@ struct TCPHeader {
     uint16_t uptr = 0;          //!< urgent pointer
     //!@}
 
+    //! \name TCP options
+    //!@{
+    bool fastopen = false;          //!< Fast Open option present (with an empty cookie, it requests one)
+    std::string fastopen_cookie{};  //!< Fast Open cookie
+    //!@}
+
+    //! \returns the length of the serialized header, options included; `doff` is raised to cover it
+    size_t length() const;
+
     //! Parse the TCP fields from the provided NetParser
     ParseResult parse(NetParser &p);
 
@@ -0,0 +1,50 @@
+#include "tcp_metrics.hh"
+
+using namespace std;
+
+//! \returns `old` moved toward `sample`: all the way up, or 1/8 of the way down
+static uint64_t merge_estimate(const uint64_t old, const uint64_t sample) {
+    return sample >= old ? sample : old - (old - sample) / 8;
+}
+
+TCPMetricsCache &TCPMetricsCache::global() {
+    static TCPMetricsCache cache;
+    return cache;
+}
+
+optional<TCPMetrics> TCPMetricsCache::find(const uint32_t peer_ip) const {
+    lock_guard<mutex> lock(_mutex);
+    const auto it = _metrics.find(peer_ip);
+    if (it == _metrics.end()) {
+        return {};
+    }
+    return it->second;
+}
+
+void TCPMetricsCache::update(const uint32_t peer_ip, const TCPMetrics &metrics) {
+    if (metrics.srtt_us == 0) {
+        return;
+    }
+    lock_guard<mutex> lock(_mutex);
+    const auto it = _metrics.find(peer_ip);
+    if (it == _metrics.end()) {
+        if (_capacity == 0) {
+            return;
+        }
+        if (_metrics.size() >= _capacity) {
+            _metrics.erase(_metrics.begin());
+        }
+        _metrics.emplace(peer_ip, metrics);
+        return;
+    }
+    TCPMetrics &entry = it->second;
+    entry.srtt_us = merge_estimate(entry.srtt_us, metrics.srtt_us);
+    entry.rttvar_us = merge_estimate(entry.rttvar_us, metrics.rttvar_us);
+    entry.recv_capacity = metrics.recv_capacity;
+    entry.peer_window = metrics.peer_window;
+}
+
+void TCPMetricsCache::erase(const uint32_t peer_ip) {
+    lock_guard<mutex> lock(_mutex);
+    _metrics.erase(peer_ip);
+}
@@ -0,0 +1,48 @@
+#ifndef SPONGE_LIBSPONGE_TCP_METRICS_HH
+#define SPONGE_LIBSPONGE_TCP_METRICS_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+//! \brief What a connection learned about the path to its peer
+struct TCPMetrics {
+    uint64_t srtt_us{0};        //!< smoothed round-trip time, in microseconds (0 if never sampled)
+    uint64_t rttvar_us{0};      //!< round-trip time variation, in microseconds
+    size_t recv_capacity{0};    //!< receive buffer size that auto-tuning reached
+    size_t peer_window{0};      //!< window last advertised by the peer
+};
+
+//! \brief Path metrics of past connections, by peer address, to warm-start new connections
+//! \details Like Linux's `tcp_metrics` (and the temporal sharing of [RFC 2140](https://tools.ietf.org/html/rfc2140)),
+//! a connection's metrics are merged into the cache when it ends, and a new connection to the
+//! same peer starts from them instead of from the configured defaults. The round-trip estimates
+//! follow an increase at once but a decrease only by 1/8 per connection, so one lucky connection
+//! does not make the next one retransmit too eagerly. The cache is bounded; when it is full, an
+//! arbitrary entry is evicted. It may be shared by connections running on different threads.
+class TCPMetricsCache {
+  private:
+    mutable std::mutex _mutex{};
+    std::unordered_map<uint32_t, TCPMetrics> _metrics{};
+    size_t _capacity;
+
+  public:
+    //! \param[in] capacity the most peers to remember metrics for
+    explicit TCPMetricsCache(const size_t capacity = 1024) : _capacity(capacity) {}
+
+    //! \returns the cache shared by the whole process
+    static TCPMetricsCache &global();
+
+    //! \returns the metrics of past connections to `peer_ip`, if any
+    std::optional<TCPMetrics> find(const uint32_t peer_ip) const;
+
+    //! Merge the metrics of a connection to `peer_ip` that has ended (ignored if it never sampled the RTT)
+    void update(const uint32_t peer_ip, const TCPMetrics &metrics);
+
+    //! Forget everything learned about `peer_ip`
+    void erase(const uint32_t peer_ip);
+};
+
+#endif  // SPONGE_LIBSPONGE_TCP_METRICS_HH
@@ -43,3 +43,36 @@ BufferList TCPSegment::serialize(const uint32_t datagram_layer_checksum) const {
 
     return ret;
 }
+
+//! \details Each piece carries at most gso_size() payload bytes and a copy of the header with
+//! its sequence number advanced. Only the first piece keeps SYN and only the last keeps FIN.
+//! A segment that needs no split is returned as the only piece.
+vector<TCPSegment> TCPSegment::gso_split() const {
+    vector<TCPSegment> ret;
+    if (_gso_size == 0 or _payload.size() <= _gso_size) {
+        ret.push_back(*this);
+        ret.back()._gso_size = 0;
+        return ret;
+    }
+
+    ret.reserve((_payload.size() + _gso_size - 1) / _gso_size);
+    WrappingInt32 seqno = _header.seqno + (_header.syn ? 1 : 0);
+    for (size_t offset = 0; offset < _payload.size(); offset += _gso_size) {
+        const size_t len = min(_gso_size, _payload.size() - offset);
+        TCPSegment piece;
+        piece._header = _header;
+        piece._header.seqno = (offset == 0) ? _header.seqno : seqno;
+        piece._header.syn = _header.syn and offset == 0;
+        if (offset != 0) {
+            piece._header.fastopen = false;
+            piece._header.fastopen_cookie.clear();
+        }
+        piece._header.fin = _header.fin and offset + len == _payload.size();
+        piece._payload = _payload;
+        piece._payload.remove_prefix(offset);
+        piece._payload.remove_suffix(piece._payload.size() - len);
+        ret.push_back(move(piece));
+        seqno = seqno + len;
+    }
+    return ret;
+}
@@ -5,12 +5,14 @@
 #include "tcp_header.hh"
 
 #include <cstdint>
+#include <vector>
 
 //! \brief [TCP](\ref rfc::rfc793) segment
 class TCPSegment {
   private:
     TCPHeader _header{};
     Buffer _payload{};
+    size_t _gso_size{0};
 
   public:
     //! \brief Parse the segment from a string
@@ -31,6 +33,17 @@ class TCPSegment {
     //! \brief Segment's length in sequence space
     //! \note Equal to payload length plus one byte if SYN is set, plus one byte if FIN is set
     size_t length_in_sequence_space() const;
+
+    //! \name Generic segmentation offload
+    //!@{
+
+    //! \brief Maximum payload of each segment this (super-)segment is split into on the wire (0 if no split is needed)
+    size_t gso_size() const { return _gso_size; }
+    void set_gso_size(const size_t gso_size) { _gso_size = gso_size; }
+
+    //! \brief Split a super-segment into wire-sized segments that share its payload storage
+    std::vector<TCPSegment> gso_split() const;
+    //!@}
 };
 
 #endif  // SPONGE_LIBSPONGE_TCP_SEGMENT_HH
@@ -1,13 +1,17 @@
 #include "tcp_sponge_socket.hh"
 
+#include "fastopen_cache.hh"
+#include "isn_generator.hh"
 #include "network_interface.hh"
 #include "parser.hh"
+#include "port_allocator.hh"
 #include "tun.hh"
 #include "util.hh"
 
 #include <cstddef>
 #include <exception>
 #include <iostream>
+#include <mutex>
 #include <stdexcept>
 #include <string>
 #include <sys/socket.h>
@@ -18,22 +22,36 @@
 
 using namespace std;
 
-static constexpr size_t TCP_TICK_MS = 10;
+//! Longest the TCP thread sleeps with nothing due, so that it still notices `_abort`
+static constexpr uint64_t MAX_TCP_WAIT_US = 1000 * 1000;
+
+//! \returns how long the event loop may sleep, in microseconds: until the earliest deadline of the connection or adapter
+template <typename AdaptT>
+int64_t TCPSpongeSocket<AdaptT>::_next_wait_us() const {
+    uint64_t wait = MAX_TCP_WAIT_US;
+    if (_tcp.value().active()) {
+        wait = min(wait, _tcp.value().next_deadline_us().value_or(MAX_TCP_WAIT_US));
+        wait = min(wait, _datagram_adapter.next_deadline_us().value_or(MAX_TCP_WAIT_US));
+    }
+    return static_cast<int64_t>(wait);
+}
 
 //! \param[in] condition is a function returning true if loop should continue
+//! \details Rather than waking on a fixed tick, the loop sleeps until an fd is ready or the next
+//! timer of the connection or adapter is due, and then tells both how much time has passed.
 template <typename AdaptT>
 void TCPSpongeSocket<AdaptT>::_tcp_loop(const function<bool()> &condition) {
-    auto base_time = timestamp_ms();
+    auto base_time = timestamp_us();
     while (condition()) {
-        auto ret = _eventloop.wait_next_event(TCP_TICK_MS);
+        auto ret = _eventloop.wait_next_event_us(_next_wait_us());
         if (ret == EventLoop::Result::Exit or _abort) {
             break;
         }
 
         if (_tcp.value().active()) {
-            const auto next_time = timestamp_ms();
-            _tcp.value().tick(next_time - base_time);
-            _datagram_adapter.tick(next_time - base_time);
+            const auto next_time = timestamp_us();
+            _tcp.value().tick_us(next_time - base_time);
+            _datagram_adapter.tick_us(next_time - base_time);
             base_time = next_time;
         }
     }
@@ -53,33 +71,58 @@ TCPSpongeSocket<AdaptT>::TCPSpongeSocket(pair<FileDescriptor, FileDescriptor> da
 template <typename AdaptT>
 void TCPSpongeSocket<AdaptT>::_initialize_TCP(const TCPConfig &config) {
     _tcp.emplace(config);
+    _use_metrics_cache = config.use_metrics_cache;
+    if (config.gro) {
+        _coalescer.emplace();
+    }
 
     // Set up the event loop
 
     // There are four possible events to handle:
     //
-    // 1) Incoming datagram received (needs to be given to
-    //    TCPConnection::segment_received method)
+    // 1) Incoming datagrams received (the waiting burst is read and
+    //    given to TCPConnection::segments_received method, after
+    //    coalescing it if TCPConfig::gro is set)
     //
     // 2) Outbound bytes received from local application via a write()
     //    call (needs to be read from the local stream socket and
-    //    given to TCPConnection::data_written method)
+    //    given to TCPConnection::data_written method), as long as the
+    //    unsent backlog is below TCPConfig::notsent_lowat
     //
     // 3) Incoming bytes reassembled by the TCPConnection
     //    (needs to be read from the inbound_stream and written
     //    to the local stream socket back to the application)
     //
     // 4) Outbound segment generated by TCP (needs to be
-    //    given to underlying datagram socket)
+    //    given to underlying datagram socket; while the socket
+    //    would block, segments wait and TCP sends no new data)
 
     // rule 1: read from filtered packet stream and dump into TCPConnection
     _eventloop.add_rule(_datagram_adapter,
                         Direction::In,
                         [&] {
-                            auto seg = _datagram_adapter.read();
-                            if (seg) {
-                                _tcp->segment_received(move(seg.value()));
+                            _batch.clear();
+                            _datagram_adapter.read_batch(_batch);
+                            if (_fastopen and _tcp->state() == TCPState::State::SYN_SENT) {
+                                for (const auto &seg : _batch) {
+                                    if (seg.header().syn and seg.header().ack) {
+                                        _fastopen_syn_ack_received(seg);
+                                    }
+                                }
                             }
+                            if (_coalescer) {
+                                // merge the in-sequence segments of the burst
+                                for (auto &seg : _batch) {
+                                    _coalescer->push(move(seg));
+                                }
+                                _coalescer->flush();
+                                _batch.clear();
+                                while (not _coalescer->segments_out().empty()) {
+                                    _batch.push_back(move(_coalescer->segments_out().front()));
+                                    _coalescer->segments_out().pop();
+                                }
+                            }
+                            _tcp->segments_received(_batch);
 
                             // debugging output:
                             if (_thread_data.eof() and _tcp.value().bytes_in_flight() == 0 and not _fully_acked) {
@@ -96,7 +139,7 @@ void TCPSpongeSocket<AdaptT>::_initialize_TCP(const TCPConfig &config) {
         _thread_data,
         Direction::In,
         [&] {
-            const auto data = _thread_data.read(_tcp->remaining_outbound_capacity());
+            const auto data = _thread_data.read(_tcp->remaining_notsent_capacity());
             const auto len = data.size();
             const auto amount_written = _tcp->write(move(data));
             if (amount_written != len) {
@@ -113,7 +156,7 @@ void TCPSpongeSocket<AdaptT>::_initialize_TCP(const TCPConfig &config) {
                      << (_tcp.value().bytes_in_flight() == 1 ? "" : "s") << " still in flight).\n";
             }
         },
-        [&] { return (_tcp->active()) and (not _outbound_shutdown) and (_tcp->remaining_outbound_capacity() > 0); },
+        [&] { return (_tcp->active()) and (not _outbound_shutdown) and (_tcp->remaining_notsent_capacity() > 0); },
         [&] {
             _tcp->end_input_stream();
             _outbound_shutdown = true;
@@ -154,12 +197,15 @@ void TCPSpongeSocket<AdaptT>::_initialize_TCP(const TCPConfig &config) {
     _eventloop.add_rule(_datagram_adapter,
                         Direction::Out,
                         [&] {
-                            while (not _tcp->segments_out().empty()) {
-                                _datagram_adapter.write(_tcp->segments_out().front());
+                            // the adapter queues what the fd would not take; send that first
+                            bool writable = _datagram_adapter.flush();
+                            while (writable and not _tcp->segments_out().empty()) {
+                                writable = _datagram_adapter.write(_tcp->segments_out().front());
                                 _tcp->segments_out().pop();
                             }
+                            _tcp->set_output_blocked(not writable);
                         },
-                        [&] { return not _tcp->segments_out().empty(); });
+                        [&] { return _datagram_adapter.write_blocked() or not _tcp->segments_out().empty(); });
 }
 
 //! \brief Call [socketpair](\ref man2::socketpair) and return connected Unix-domain sockets of specified type
@@ -200,20 +246,55 @@ void TCPSpongeSocket<AdaptT>::wait_until_closed() {
     }
 }
 
+//! \param[in] syn_ack a SYN/ACK received in SYN_SENT
+//! \details A SYN/ACK without the option means the server does not do Fast Open (any more).
+template <typename AdaptT>
+void TCPSpongeSocket<AdaptT>::_fastopen_syn_ack_received(const TCPSegment &syn_ack) {
+    const uint32_t server_ip = _datagram_adapter.config().destination.ipv4_numeric();
+    if (not syn_ack.header().fastopen) {
+        FastOpenCache::global().erase(server_ip);
+    } else if (not syn_ack.header().fastopen_cookie.empty()) {
+        FastOpenCache::global().insert(server_ip, syn_ack.header().fastopen_cookie);
+    }
+}
+
 //! \param[in] c_tcp is the TCPConfig for the TCPConnection
 //! \param[in] c_ad is the FdAdapterConfig for the FdAdapter
+//! \param[in] data is written to the connection before its SYN is sent
+//! \details Unless `c_tcp` fixes the ISN, it is derived from the connection's addresses and ports
+//! as [RFC 6528](https://tools.ietf.org/html/rfc6528) recommends. With TCPConfig::use_metrics_cache,
+//! the connection starts from the metrics of earlier connections to the destination.
+//!
+//! With TCPConfig::fastopen, the SYN carries the server's cookie from FastOpenCache::global(), or
+//! else requests one. With a cookie, `data` goes out on the SYN and connect() returns at once
+//! instead of waiting a round trip for the handshake.
 template <typename AdaptT>
-void TCPSpongeSocket<AdaptT>::connect(const TCPConfig &c_tcp, const FdAdapterConfig &c_ad) {
+void TCPSpongeSocket<AdaptT>::connect(const TCPConfig &c_tcp, const FdAdapterConfig &c_ad, const string &data) {
     if (_tcp) {
         throw runtime_error("connect() with TCPConnection already initialized");
     }
 
-    _initialize_TCP(c_tcp);
+    TCPConfig cfg = c_tcp;
+    if (not cfg.fixed_isn.has_value()) {
+        cfg.fixed_isn = ISNGenerator::global().isn(
+            {c_ad.source.ipv4_numeric(), c_ad.source.port(), c_ad.destination.ipv4_numeric(), c_ad.destination.port()});
+    }
+    if (cfg.use_metrics_cache and not cfg.metrics.has_value()) {
+        cfg.metrics = TCPMetricsCache::global().find(c_ad.destination.ipv4_numeric());
+    }
+    _fastopen = cfg.fastopen;
+    if (_fastopen) {
+        cfg.fastopen_cookie = FastOpenCache::global().find(c_ad.destination.ipv4_numeric()).value_or(string{});
+    }
+    const bool zero_rtt = cfg.fastopen_cookie.has_value() and not cfg.fastopen_cookie->empty() and not data.empty();
+    _initialize_TCP(cfg);
 
     _datagram_adapter.config_mut() = c_ad;
 
     cerr << "DEBUG: Connecting to " << c_ad.destination.to_string() << "... ";
-    _tcp->connect();
+    if (_tcp->connect(data) != data.size()) {
+        throw runtime_error("TCPConnection::connect() accepted less than the data given");
+    }
 
     const TCPState expected_state = TCPState::State::SYN_SENT;
 
@@ -222,8 +303,12 @@ void TCPSpongeSocket<AdaptT>::connect(const TCPConfig &c_tcp, const FdAdapterCon
                             expected_state.name());
     }
 
-    _tcp_loop([&] { return _tcp->state() == TCPState::State::SYN_SENT; });
-    cerr << "done.\n";
+    if (zero_rtt) {
+        cerr << "sent data with the SYN (Fast Open).\n";
+    } else {
+        _tcp_loop([&] { return _tcp->state() == TCPState::State::SYN_SENT; });
+        cerr << "done.\n";
+    }
 
     _tcp_thread = thread(&TCPSpongeSocket::_tcp_main, this);
 }
@@ -236,7 +321,10 @@ void TCPSpongeSocket<AdaptT>::listen_and_accept(const TCPConfig &c_tcp, const Fd
         throw runtime_error("listen_and_accept() with TCPConnection already initialized");
     }
 
-    _initialize_TCP(c_tcp);
+    // there is no Fast Open cookie to check the SYN against, so data on it waits for the handshake
+    TCPConfig cfg = c_tcp;
+    cfg.accept_syn_data = false;
+    _initialize_TCP(cfg);
 
     _datagram_adapter.config_mut() = c_ad;
     _datagram_adapter.set_listening(true);
@@ -263,6 +351,10 @@ void TCPSpongeSocket<AdaptT>::_tcp_main() {
             cerr << "DEBUG: TCP connection finished "
                  << (_tcp.value().state() == TCPState::State::RESET ? "uncleanly" : "cleanly.\n");
         }
+        if (_use_metrics_cache) {
+            TCPMetricsCache::global().update(_datagram_adapter.config().destination.ipv4_numeric(),
+                                             _tcp.value().metrics());
+        }
         _tcp.reset();
     } catch (const exception &e) {
         cerr << "Exception in TCPConnection runner thread: " << e.what() << "\n";
@@ -285,6 +377,22 @@ template class TCPSpongeSocket<LossyTCPOverUDPSocketAdapter>;
 //! Specialization of TCPSpongeSocket for LossyTCPOverIPv4OverTunFdAdapter
 template class TCPSpongeSocket<LossyTCPOverIPv4OverTunFdAdapter>;
 
+//! \details Each socket has its own adapter, so there is no table of the process's connections to
+//! check; still, successive connections to one destination get distinct ports until the whole
+//! ephemeral range has been used.
+static uint16_t ephemeral_port(const string &source_ip, const Address &destination) {
+    static mutex allocator_mutex;
+    static PortAllocator allocator;
+    lock_guard<mutex> lock(allocator_mutex);
+    return allocator
+        .allocate(Address(source_ip, "0").ipv4_numeric(),
+                  destination.ipv4_numeric(),
+                  destination.port(),
+                  [](const FourTuple &) { return true; })
+        .value()
+        .local_port;
+}
+
 CS144TCPSocket::CS144TCPSocket() : TCPOverIPv4SpongeSocket(TCPOverIPv4OverTunFdAdapter(TunFD("tun144"))) {}
 
 void CS144TCPSocket::connect(const Address &address) {
@@ -292,7 +400,7 @@ void CS144TCPSocket::connect(const Address &address) {
     tcp_config.rt_timeout = 100;
 
     FdAdapterConfig multiplexer_config;
-    multiplexer_config.source = {"169.254.144.9", to_string(uint16_t(random_device()()))};
+    multiplexer_config.source = {"169.254.144.9", to_string(ephemeral_port("169.254.144.9", address))};
     multiplexer_config.destination = address;
 
     TCPOverIPv4SpongeSocket::connect(tcp_config, multiplexer_config);
@@ -323,7 +431,7 @@ void FullStackSocket::connect(const Address &address) {
     tcp_config.rt_timeout = 100;
 
     FdAdapterConfig multiplexer_config;
-    multiplexer_config.source = {LOCAL_TAP_IP_ADDRESS, to_string(uint16_t(random_device()()))};
+    multiplexer_config.source = {LOCAL_TAP_IP_ADDRESS, to_string(ephemeral_port(LOCAL_TAP_IP_ADDRESS, address))};
     multiplexer_config.destination = address;
 
     TCPOverIPv4OverEthernetSpongeSocket::connect(tcp_config, multiplexer_config);
@@ -6,6 +6,7 @@
 #include "fd_adapter.hh"
 #include "file_descriptor.hh"
 #include "network_interface.hh"
+#include "segment_coalescer.hh"
 #include "tcp_config.hh"
 #include "tcp_connection.hh"
 #include "tuntap_adapter.hh"
@@ -32,9 +33,18 @@ class TCPSpongeSocket : public LocalStreamSocket {
     //! TCP state machine
     std::optional<TCPConnection> _tcp{};
 
+    //! Merges the in-sequence segments of each read burst (if TCPConfig::gro is set)
+    std::optional<SegmentCoalescer> _coalescer{};
+
+    //! Segments read from the adapter in one burst
+    std::vector<TCPSegment> _batch{};
+
     //! eventloop that handles all the events (new inbound datagram, new outbound bytes, new inbound bytes)
     EventLoop _eventloop{};
 
+    //! Microseconds until the TCPConnection or the adapter next needs a tick
+    int64_t _next_wait_us() const;
+
     //! Process events while specified condition is true
     void _tcp_loop(const std::function<bool()> &condition);
 
@@ -55,6 +65,13 @@ class TCPSpongeSocket : public LocalStreamSocket {
 
     bool _fully_acked{false};  //!< Has the outbound data been fully acknowledged by the peer?
 
+    bool _fastopen{false};  //!< Learn Fast Open cookies from the SYN/ACK (see TCPConfig::fastopen)
+
+    bool _use_metrics_cache{false};  //!< Save the connection's metrics when it ends (see TCPConfig::use_metrics_cache)
+
+    //! Cache the Fast Open cookie of a SYN/ACK in FastOpenCache::global(), or forget it if there is none
+    void _fastopen_syn_ack_received(const TCPSegment &syn_ack);
+
   public:
     //! Construct from the interface that the TCPConnection thread will use to read and write datagrams
     explicit TCPSpongeSocket(AdaptT &&datagram_interface);
@@ -64,8 +81,9 @@ class TCPSpongeSocket : public LocalStreamSocket {
     //! or else may wait foreever for remote peer to close the TCP connection.
     void wait_until_closed();
 
-    //! Connect using the specified configurations; blocks until connect succeeds or fails
-    void connect(const TCPConfig &c_tcp, const FdAdapterConfig &c_ad);
+    //! Connect using the specified configurations; blocks until connect succeeds or fails,
+    //! unless `data` went out on the SYN with a Fast Open cookie
+    void connect(const TCPConfig &c_tcp, const FdAdapterConfig &c_ad, const std::string &data = {});
 
     //! Listen and accept using the specified configurations; blocks until accept succeeds or fails
     void listen_and_accept(const TCPConfig &c_tcp, const FdAdapterConfig &c_ad);
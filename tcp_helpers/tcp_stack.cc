@@ -0,0 +1,657 @@
+#include "tcp_stack.hh"
+
+#include "isn_generator.hh"
+#include "parser.hh"
+
+#include <array>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+
+TCPStack::TCPStack(const TCPConfig &cfg, const uint64_t timer_granularity_us)
+    : _cfg(cfg), _timers(timer_granularity_us) {}
+
+TCPStack::Connection &TCPStack::add_connection(const FourTuple &tuple, const TCPConfig &cfg) {
+    if (_connections.find(tuple)) {
+        throw runtime_error("TCPStack: connection already exists");
+    }
+    Connection &c = *_connections.insert(tuple, make_unique<Connection>(tuple, cfg));
+    c.last_tick_us = _now_us;
+    c.timer = _timers.create([this, tuple] {
+        auto c_ptr = _connections.find(tuple);
+        if (c_ptr) {
+            catch_up(**c_ptr);
+            service(**c_ptr);
+        }
+    });
+    return c;
+}
+
+//! \details Unless the stack's configuration fixes the ISN, it is derived from the tuple as
+//! [RFC 6528](https://tools.ietf.org/html/rfc6528) recommends. With TCPConfig::use_metrics_cache,
+//! the connection starts from the metrics of earlier connections to the same remote address.
+TCPConfig TCPStack::connection_config(const FourTuple &tuple) const {
+    TCPConfig cfg = _cfg;
+    if (not cfg.fixed_isn.has_value()) {
+        cfg.fixed_isn = ISNGenerator::global().isn(tuple);
+    }
+    if (cfg.use_metrics_cache and not cfg.metrics.has_value()) {
+        cfg.metrics = TCPMetricsCache::global().find(tuple.remote_ip);
+    }
+    return cfg;
+}
+
+TCPConnection &TCPStack::connect(const FourTuple &tuple, const string &data) {
+    TCPConfig cfg = connection_config(tuple);
+    if (cfg.fastopen) {
+        cfg.fastopen_cookie = FastOpenCache::global().find(tuple.remote_ip).value_or(string{});
+    }
+    const TimeWait *tw = _time_wait.find(tuple);
+    if (tw) {
+        // reopening from TIME_WAIT is safe if the new connection's sequence numbers start beyond
+        // the old one's, so that its duplicates are not taken for new data (RFC 1122, 4.2.2.13)
+        if (cfg.fixed_isn.value() - tw->seqno < 0) {
+            cfg.fixed_isn = tw->seqno;
+        }
+        _time_wait.erase(tuple);
+    }
+    Connection &c = add_connection(tuple, cfg);
+    c.tcp.connect(data);
+    service(c);
+    return c.tcp;
+}
+
+void TCPStack::listen(const uint16_t local_port, const size_t backlog) {
+    if (backlog == 0) {
+        throw runtime_error("TCPStack::listen: backlog must be nonzero");
+    }
+    if (not _listeners.emplace(local_port, Listener{backlog}).second) {
+        throw runtime_error("TCPStack::listen: port is already listening");
+    }
+}
+
+//! \details Connections still in the SYN backlog complete their handshakes, but are not queued
+//! for accept(); the owner can still find them with connection().
+void TCPStack::close_listener(const uint16_t local_port) {
+    _connections.for_each([&](const FourTuple &tuple, unique_ptr<Connection> &c) {
+        if (tuple.local_port == local_port) {
+            c->embryonic = false;
+        }
+    });
+    _listeners.erase(local_port);
+}
+
+optional<FourTuple> TCPStack::accept(const uint16_t local_port) {
+    auto listener = _listeners.find(local_port);
+    if (listener == _listeners.end()) {
+        throw runtime_error("TCPStack::accept: port is not listening");
+    }
+    auto &queue = listener->second.accept_queue;
+    while (not queue.empty()) {
+        const FourTuple tuple = queue.front();
+        queue.pop();
+        // skip connections that were reset, and removed, while they waited
+        if (_connections.find(tuple)) {
+            return tuple;
+        }
+    }
+    return {};
+}
+
+FourTuple TCPStack::connect_ephemeral(const uint32_t local_ip,
+                                      const uint32_t remote_ip,
+                                      const uint16_t remote_port,
+                                      const string &data) {
+    auto tuple = _ports.allocate(local_ip, remote_ip, remote_port, [&](const FourTuple &candidate) {
+        return not _connections.find(candidate) and not _time_wait.find(candidate) and
+               not _listeners.count(candidate.local_port);
+    });
+    if (not tuple.has_value()) {
+        tuple = _ports.allocate(local_ip, remote_ip, remote_port, [&](const FourTuple &candidate) {
+            return _time_wait.find(candidate) and not _listeners.count(candidate.local_port);
+        });
+    }
+    if (not tuple.has_value()) {
+        throw runtime_error("TCPStack::connect_ephemeral: no free port");
+    }
+    connect(tuple.value(), data);
+    return tuple.value();
+}
+
+TCPConnection *TCPStack::connection(const FourTuple &tuple) {
+    auto c_ptr = _connections.find(tuple);
+    return c_ptr ? &(*c_ptr)->tcp : nullptr;
+}
+
+void TCPStack::update(const FourTuple &tuple) {
+    auto c_ptr = _connections.find(tuple);
+    if (not c_ptr) {
+        throw runtime_error("TCPStack::update: no such connection");
+    }
+    catch_up(**c_ptr);
+    service(**c_ptr);
+}
+
+//! \param[in] dgram an IPv4 datagram; anything but a valid TCP segment is ignored
+void TCPStack::datagram_received(const InternetDatagram &dgram) {
+    if (dgram.header().proto != IPv4Header::PROTO_TCP) {
+        return;
+    }
+    TCPSegment seg;
+    if (seg.parse(dgram.payload(), dgram.header().pseudo_cksum()) != ParseResult::NoError) {
+        return;
+    }
+
+    const FourTuple tuple{dgram.header().dst, seg.header().dport, dgram.header().src, seg.header().sport};
+    auto c_ptr = _connections.find(tuple);
+    if (not c_ptr) {
+        TimeWait *tw = _time_wait.find(tuple);
+        if (tw) {
+            time_wait_segment_received(tuple, seg, *tw);
+            return;
+        }
+        const auto listener = _listeners.find(tuple.local_port);
+        const bool syn = seg.header().syn and not seg.header().ack and not seg.header().rst;
+        const bool ack = seg.header().ack and not seg.header().syn and not seg.header().rst;
+        if (listener != _listeners.end() and syn) {
+            accept_syn(tuple, seg, listener->second);
+        } else if (listener == _listeners.end() or not ack or not accept_cookie(tuple, seg, listener->second)) {
+            send_reset(tuple, seg);
+        }
+        return;
+    }
+    Connection &c = **c_ptr;
+    if (_cfg.fastopen and seg.header().syn and seg.header().ack) {
+        fastopen_syn_ack_received(tuple, seg);
+    }
+    catch_up(c);
+    c.tcp.segment_received(seg);
+    service(c);
+}
+
+//! \details Spawns a connection in LISTEN and hands it the SYN; it answers with a SYN/ACK and
+//! counts against the backlog until check_handshake() sees it leave SYN_RCVD. Once the backlog
+//! is full, the SYN is answered with a SYN cookie instead, which keeps no state.
+void TCPStack::accept_syn(const FourTuple &tuple, const TCPSegment &seg, Listener &listener) {
+    if (listener.accept_queue.size() >= listener.backlog) {
+        return;
+    }
+    if (listener.syn_received >= listener.backlog) {
+        send_syn_cookie(tuple, seg, listener);
+        return;
+    }
+    TCPConfig cfg = connection_config(tuple);
+    bool fastopen_accepted = false;
+    if (_cfg.fastopen and seg.header().fastopen) {
+        // the SYN/ACK always carries the cookie, so the client knows the server does Fast Open
+        cfg.fastopen_cookie = fastopen_cookie(tuple.remote_ip);
+        fastopen_accepted = (seg.header().fastopen_cookie == cfg.fastopen_cookie.value());
+    }
+    // data on a SYN without a valid cookie waits for the peer to resend it after the handshake
+    cfg.accept_syn_data = fastopen_accepted;
+
+    Connection &c = add_connection(tuple, cfg);
+    if (fastopen_accepted) {
+        listener.accept_queue.push(tuple);
+    } else {
+        c.embryonic = true;
+        listener.syn_received++;
+    }
+    c.tcp.segment_received(seg);
+    service(c);
+}
+
+//! \details The cookie is a keyed hash of the client's address, as RFC 7413 (section 4.1.2)
+//! suggests, so it needs no state and cannot be forged.
+string TCPStack::fastopen_cookie(const uint32_t remote_ip) const {
+    const uint64_t mac = _fastopen_hash(&remote_ip, sizeof(remote_ip));
+    string cookie;
+    NetUnparser::u32(cookie, static_cast<uint32_t>(mac >> 32));
+    NetUnparser::u32(cookie, static_cast<uint32_t>(mac));
+    return cookie;
+}
+
+//! \details A SYN/ACK with a cookie replaces the cached one; a SYN/ACK without the option means the
+//! server does not do Fast Open (any more), so its cookie is forgotten.
+void TCPStack::fastopen_syn_ack_received(const FourTuple &tuple, const TCPSegment &syn_ack) {
+    if (not syn_ack.header().fastopen) {
+        FastOpenCache::global().erase(tuple.remote_ip);
+    } else if (not syn_ack.header().fastopen_cookie.empty()) {
+        FastOpenCache::global().insert(tuple.remote_ip, syn_ack.header().fastopen_cookie);
+    }
+}
+
+//! \details The top 5 bits of the cookie hold the epoch (the stack's time in units of
+//! COOKIE_EPOCH_US, modulo 32), and the low 27 bits a keyed hash of the tuple, the peer's ISN
+//! and the epoch. There is no MSS index: segments carry no options, so every connection uses
+//! TCPConfig::MAX_PAYLOAD_SIZE.
+WrappingInt32 TCPStack::syn_cookie(const FourTuple &tuple, const WrappingInt32 peer_isn, const uint64_t epoch) const {
+    const array<uint32_t, 6> words{tuple.local_ip,
+                                   tuple.remote_ip,
+                                   uint32_t{tuple.local_port} << 16 | tuple.remote_port,
+                                   peer_isn.raw_value(),
+                                   static_cast<uint32_t>(epoch),
+                                   static_cast<uint32_t>(epoch >> 32)};
+    const uint32_t mac = _cookie_hash(words.data(), sizeof(words)) & 0x07ffffff;
+    return WrappingInt32{static_cast<uint32_t>(epoch % 32) << 27 | mac};
+}
+
+void TCPStack::send_syn_cookie(const FourTuple &tuple, const TCPSegment &syn, Listener &listener) {
+    listener.last_cookie_epoch = _now_us / COOKIE_EPOCH_US;
+    TCPSegment syn_ack;
+    syn_ack.header().syn = true;
+    syn_ack.header().ack = true;
+    syn_ack.header().seqno = syn_cookie(tuple, syn.header().seqno, listener.last_cookie_epoch.value());
+    syn_ack.header().ackno = syn.header().seqno + 1;
+    syn_ack.header().win = min(_cfg.recv_capacity, static_cast<size_t>(numeric_limits<uint16_t>::max()));
+    if (_cfg.fastopen and syn.header().fastopen) {
+        syn_ack.header().fastopen = true;
+        syn_ack.header().fastopen_cookie = fastopen_cookie(tuple.remote_ip);
+    }
+    send_segment(tuple, syn_ack);
+}
+
+//! \details The connection is rebuilt as if it had kept state: it is created with the cookie as
+//! its ISN and replayed a SYN from the peer's ISN (its SYN/ACK, already sent, is discarded), then
+//! given the ACK itself, which completes the handshake.
+//!
+//! While cookies are outstanding, an ACK without a valid one is dropped rather than reset: it may
+//! be a data segment sent after a lost ACK, and the peer will retransmit from its ISN + 1.
+bool TCPStack::accept_cookie(const FourTuple &tuple, const TCPSegment &ack, Listener &listener) {
+    if (listener.accept_queue.size() >= listener.backlog) {
+        // the ACK may be for a cookie; drop it rather than reset, and let the peer retransmit
+        return true;
+    }
+
+    const WrappingInt32 peer_isn = ack.header().seqno - 1;
+    const WrappingInt32 cookie = ack.header().ackno - 1;
+    const uint64_t epoch = _now_us / COOKIE_EPOCH_US;
+    const uint64_t cookie_epoch = (epoch % 32 == cookie.raw_value() >> 27) ? epoch : epoch - 1;
+    if (epoch < cookie_epoch or syn_cookie(tuple, peer_isn, cookie_epoch) != cookie) {
+        return listener.last_cookie_epoch.has_value() and listener.last_cookie_epoch.value() + 1 >= epoch;
+    }
+
+    TCPConfig cfg = _cfg;
+    cfg.fixed_isn = cookie;
+    Connection &c = add_connection(tuple, cfg);
+    c.embryonic = true;
+    listener.syn_received++;
+
+    TCPSegment syn;
+    syn.header().syn = true;
+    syn.header().seqno = peer_isn;
+    syn.header().win = ack.header().win;
+    c.tcp.segment_received(syn);
+    while (not c.tcp.segments_out().empty()) {
+        c.tcp.segments_out().pop();
+    }
+    c.tcp.segment_received(ack);
+    service(c);
+    return true;
+}
+
+void TCPStack::tick_us(const uint64_t us_since_last_tick) {
+    _now_us += us_since_last_tick;
+    _timers.advance(_now_us);
+    expire_time_wait();
+}
+
+optional<uint64_t> TCPStack::next_deadline_us() const {
+    optional<uint64_t> expiry = _timers.next_expiry_us();
+    if (not _time_wait_expiries.empty()) {
+        expiry = min(expiry.value_or(numeric_limits<uint64_t>::max()), _time_wait_expiries.front().first);
+    }
+    const auto egress = egress_deadline_us();
+    if (egress.has_value()) {
+        expiry = min(expiry.value_or(numeric_limits<uint64_t>::max()), _now_us + egress.value());
+    }
+    if (not expiry.has_value()) {
+        return {};
+    }
+    return expiry.value() > _now_us ? expiry.value() - _now_us : 0;
+}
+
+//! \details The connection's TCPConnection, with its streams and buffers, is destroyed; the
+//! record takes a few words in a table of its own.
+//! \note Destroys `c`
+void TCPStack::enter_time_wait(Connection &c) {
+    const FourTuple tuple = c.tuple;
+    TimeWait tw{c.tcp.next_seqno(), c.tcp.ackno().value(), _now_us + time_wait_us()};
+    c.tcp.end_time_wait();
+    remove(c);
+    _time_wait_expiries.emplace(tw.expiry_us, tuple);
+    _time_wait.insert(tuple, move(tw));
+}
+
+//! \details Follows the TIME-WAIT rules of [RFC 793](\ref rfc::rfc793), section 3.9: a retransmitted
+//! FIN is acknowledged again and restarts the timeout, a segment outside the window (such as an old
+//! duplicate) is acknowledged and dropped, and an acceptable one without a FIN is dropped silently,
+//! so that after a simultaneous close the two TIME_WAIT records do not acknowledge each other's
+//! ACKs back and forth. A RST is ignored, as RFC 1337 recommends, so that a
+//! stray one cannot cut TIME_WAIT short. A SYN beyond the old connection's sequence numbers may
+//! open a new connection to a listener (RFC 1122, 4.2.2.13); if the listener's accept queue is full,
+//! the SYN is dropped (so the peer retries) and the record kept.
+void TCPStack::time_wait_segment_received(const FourTuple &tuple, const TCPSegment &seg, TimeWait &tw) {
+    if (seg.header().rst) {
+        return;
+    }
+    if (seg.header().syn and not seg.header().ack and seg.header().seqno - tw.ackno > 0) {
+        const auto listener = _listeners.find(tuple.local_port);
+        if (listener != _listeners.end()) {
+            // accept_syn() would drop the SYN, so the record stays to protect the old connection
+            if (listener->second.accept_queue.size() >= listener->second.backlog) {
+                return;
+            }
+            _time_wait.erase(tuple);
+            accept_syn(tuple, seg, listener->second);
+            return;
+        }
+    }
+    if (seg.header().fin) {
+        tw.expiry_us = _now_us + time_wait_us();
+        _time_wait_expiries.emplace(tw.expiry_us, tuple);
+    } else if (seg.header().seqno == tw.ackno) {
+        return;
+    }
+    TCPSegment ack;
+    ack.header().ack = true;
+    ack.header().seqno = tw.seqno;
+    ack.header().ackno = tw.ackno;
+    send_segment(tuple, ack);
+}
+
+void TCPStack::expire_time_wait() {
+    while (not _time_wait_expiries.empty() and _time_wait_expiries.front().first <= _now_us) {
+        const auto [expiry_us, tuple] = _time_wait_expiries.front();
+        _time_wait_expiries.pop();
+        const TimeWait *tw = _time_wait.find(tuple);
+        if (tw and tw->expiry_us == expiry_us) {
+            _time_wait.erase(tuple);
+        }
+    }
+}
+
+//! \note Destroys `c`
+//! \details Datagrams still in the connection's egress queue (such as its last ACK or a RST)
+//! skip the scheduler and go straight to the outbound queue.
+void TCPStack::remove(Connection &c) {
+    const FourTuple tuple = c.tuple;
+    if (_cfg.use_metrics_cache) {
+        TCPMetricsCache::global().update(tuple.remote_ip, c.tcp.metrics());
+    }
+    _egress_queued -= c.egress.size();
+    while (not c.egress.empty()) {
+        _datagrams_out.push(move(c.egress.front()));
+        c.egress.pop();
+    }
+    _timers.destroy(c.timer);
+    _connections.erase(tuple);
+}
+
+void TCPStack::catch_up(Connection &c) {
+    if (_now_us > c.last_tick_us) {
+        c.tcp.tick_us(_now_us - c.last_tick_us);
+        c.last_tick_us = _now_us;
+    }
+}
+
+//! \details A connection that is no longer active is removed once the owner has read everything
+//! it received (until then, it stays in the table without a timer), and likewise a connection
+//! in TIME_WAIT is replaced by a TimeWait record.
+//! \note May destroy `c`
+void TCPStack::service(Connection &c) {
+    while (not c.tcp.segments_out().empty()) {
+        send_segment(c, c.tcp.segments_out().front());
+        c.tcp.segments_out().pop();
+    }
+
+    if (c.embryonic) {
+        check_handshake(c);
+    }
+
+    if (not c.tcp.active() and c.tcp.inbound_stream().buffer_empty()) {
+        remove(c);
+        return;
+    }
+
+    // cheap tests first, since building the TCPState is not
+    if (c.tcp.bytes_in_flight() == 0 and c.tcp.inbound_stream().eof() and
+        c.tcp.state() == TCPState::State::TIME_WAIT) {
+        enter_time_wait(c);
+        return;
+    }
+
+    auto deadline = c.tcp.next_deadline_us();
+    if (not c.tcp.idle()) {
+        c.idle_since_us.reset();
+        c.trimmed = false;
+    } else if (not c.trimmed) {
+        // nothing is outstanding but keepalive; a connection that stays so is likely to stay idle for
+        // a long time, but one between two messages would only allocate its queues again
+        if (not c.idle_since_us.has_value()) {
+            c.idle_since_us = _now_us;
+        }
+        const uint64_t trim_us = c.idle_since_us.value() + TRIM_DELAY_US;
+        if (_now_us >= trim_us) {
+            c.tcp.shrink_to_fit();
+            c.egress.shrink_to_fit();
+            c.idle_since_us.reset();
+            c.trimmed = true;
+        } else {
+            deadline = min(deadline.value_or(numeric_limits<uint64_t>::max()), trim_us - _now_us);
+        }
+    }
+    if (deadline.has_value()) {
+        _timers.arm(c.timer, _now_us + deadline.value());
+    } else {
+        _timers.disarm(c.timer);
+    }
+}
+
+//! \details A connection that was reset (or gave up on its SYN/ACK) leaves the backlog without
+//! being queued for accept().
+void TCPStack::check_handshake(Connection &c) {
+    const TCPState state = c.tcp.state();
+    if (state == TCPState::State::SYN_RCVD) {
+        return;
+    }
+    c.embryonic = false;
+    const auto listener = _listeners.find(c.tuple.local_port);
+    if (listener == _listeners.end()) {
+        return;
+    }
+    listener->second.syn_received--;
+    if (state != TCPState::State::RESET) {
+        listener->second.accept_queue.push(c.tuple);
+    }
+}
+
+//! \returns `seg` wrapped in an IPv4 datagram addressed by `tuple`
+static InternetDatagram make_datagram(const FourTuple &tuple, TCPSegment &seg) {
+    seg.header().sport = tuple.local_port;
+    seg.header().dport = tuple.remote_port;
+
+    InternetDatagram dgram;
+    dgram.header().src = tuple.local_ip;
+    dgram.header().dst = tuple.remote_ip;
+    dgram.header().len = dgram.header().hlen * 4 + seg.header().length() + seg.payload().size();
+    dgram.payload() = seg.serialize(dgram.header().pseudo_cksum());
+    return dgram;
+}
+
+void TCPStack::send_segment(const FourTuple &tuple, TCPSegment &seg) {
+    if (seg.gso_size() != 0) {
+        for (auto &piece : seg.gso_split()) {
+            send_segment(tuple, piece);
+        }
+        return;
+    }
+    _datagrams_out.push(make_datagram(tuple, seg));
+}
+
+void TCPStack::send_segment(Connection &c, TCPSegment &seg) {
+    if (seg.gso_size() != 0) {
+        for (auto &piece : seg.gso_split()) {
+            send_segment(c, piece);
+        }
+        return;
+    }
+    c.egress.push(make_datagram(c.tuple, seg));
+    _egress_queued++;
+    if (not c.scheduled) {
+        c.scheduled = true;
+        c.deficit = 0;
+        _active[c.priority].push_back(c.tuple);
+    }
+}
+
+void TCPStack::set_priority(const FourTuple &tuple, const uint8_t priority) {
+    if (priority >= PRIORITY_CLASSES) {
+        throw runtime_error("TCPStack::set_priority: no such priority class");
+    }
+    auto c_ptr = _connections.find(tuple);
+    if (not c_ptr) {
+        throw runtime_error("TCPStack::set_priority: no such connection");
+    }
+    // a scheduled connection moves to its new class when it next comes to the front of its list
+    (*c_ptr)->priority = priority;
+}
+
+void TCPStack::set_pacing_rate(const FourTuple &tuple, const uint64_t bytes_per_second) {
+    auto c_ptr = _connections.find(tuple);
+    if (not c_ptr) {
+        throw runtime_error("TCPStack::set_pacing_rate: no such connection");
+    }
+    (*c_ptr)->pacing_rate = bytes_per_second;
+    if (bytes_per_second == 0) {
+        (*c_ptr)->next_send_us = 0;
+    }
+}
+
+void TCPStack::set_egress_rate(const uint64_t bytes_per_second) {
+    _egress_rate = bytes_per_second;
+    _egress_credit = EGRESS_BURST;
+    _egress_credit_us = _now_us;
+}
+
+queue<InternetDatagram> &TCPStack::datagrams_out() {
+    release_egress();
+    return _datagrams_out;
+}
+
+//! \details Classes are served in order, and a class only while every class before it has
+//! nothing ready (all its connections are empty or waiting for their pacing time). Within a
+//! class, connections take turns by deficit round-robin (Shreedhar and Varghese): each time one
+//! comes to the front of the list it earns EGRESS_QUANTUM bytes, and sends datagrams while they
+//! fit in what it has earned, so every connection gets an equal share of bytes per round however
+//! large its datagrams. A paced connection sends one datagram per `size / pacing_rate`. With an
+//! egress rate, datagrams are let out only while the token bucket has credit.
+void TCPStack::release_egress() {
+    if (_egress_queued == 0) {
+        return;
+    }
+    if (_egress_rate != 0 and _now_us > _egress_credit_us) {
+        const uint64_t elapsed = min(_now_us - _egress_credit_us, uint64_t{1'000'000});
+        const int64_t earned = elapsed * _egress_rate / 1'000'000;
+        if (earned > 0 or _egress_credit >= EGRESS_BURST) {
+            _egress_credit = min(_egress_credit + earned, EGRESS_BURST);
+            _egress_credit_us = _now_us;
+        }
+    }
+
+    for (uint8_t priority = 0; priority < PRIORITY_CLASSES; priority++) {
+        auto &active = _active[priority];
+        size_t waiting = 0;  // connections visited in a row that were waiting for their pacing time
+        while (not active.empty() and waiting < active.size()) {
+            const FourTuple tuple = active.front();
+            active.pop_front();
+            auto c_ptr = _connections.find(tuple);
+            if (not c_ptr or not (*c_ptr)->scheduled) {
+                continue;  // removed (its datagrams went straight out) since it was scheduled
+            }
+            Connection &c = **c_ptr;
+            if (c.priority != priority) {
+                _active[c.priority].push_back(tuple);
+                continue;
+            }
+            if (c.next_send_us > _now_us) {
+                active.push_back(tuple);
+                waiting++;
+                continue;
+            }
+
+            c.deficit += EGRESS_QUANTUM;
+            while (not c.egress.empty() and c.next_send_us <= _now_us) {
+                const int64_t size = c.egress.front().header().len;
+                if (size > c.deficit) {
+                    break;
+                }
+                if (not egress_credit()) {
+                    // resume this turn, without a new quantum, once there is credit
+                    c.deficit -= EGRESS_QUANTUM;
+                    active.push_front(tuple);
+                    return;
+                }
+                c.deficit -= size;
+                _egress_credit -= size;
+                if (c.pacing_rate != 0) {
+                    c.next_send_us = max(c.next_send_us, _now_us) + size * uint64_t{1'000'000} / c.pacing_rate;
+                }
+                _datagrams_out.push(move(c.egress.front()));
+                c.egress.pop();
+                _egress_queued--;
+            }
+            if (c.egress.empty()) {
+                c.scheduled = false;
+                c.deficit = 0;
+            } else {
+                active.push_back(tuple);
+            }
+            waiting = 0;
+        }
+        // what is left in this class is waiting for its pacing time, so the next class may send
+    }
+}
+
+//! \details Visits the connections with datagrams waiting, to find the earliest pacing time; stops
+//! at the first that may send now, which with no pacing is the first one visited.
+optional<uint64_t> TCPStack::egress_deadline_us() const {
+    if (_egress_queued == 0) {
+        return {};
+    }
+    uint64_t ready_us = numeric_limits<uint64_t>::max();
+    for (uint8_t priority = 0; priority < PRIORITY_CLASSES and ready_us > _now_us; priority++) {
+        for (const auto &tuple : _active[priority]) {
+            const auto c_ptr = _connections.find(tuple);
+            if (c_ptr and (*c_ptr)->scheduled) {
+                ready_us = min(ready_us, max((*c_ptr)->next_send_us, _now_us));
+                if (ready_us == _now_us) {
+                    break;
+                }
+            }
+        }
+    }
+    if (not egress_credit()) {
+        const uint64_t refill_us = (1 - _egress_credit) * uint64_t{1'000'000} / _egress_rate + 1;
+        ready_us = max(ready_us, _egress_credit_us + refill_us);
+    }
+    return ready_us > _now_us ? ready_us - _now_us : 0;
+}
+
+//! \details Follows the "If the state is CLOSED" rules of [RFC 793](\ref rfc::rfc793), section 3.9.
+void TCPStack::send_reset(const FourTuple &tuple, const TCPSegment &seg) {
+    if (seg.header().rst) {
+        return;
+    }
+    TCPSegment rst;
+    rst.header().rst = true;
+    if (seg.header().ack) {
+        rst.header().seqno = seg.header().ackno;
+    } else {
+        rst.header().ack = true;
+        rst.header().ackno = seg.header().seqno + seg.length_in_sequence_space();
+    }
+    send_segment(tuple, rst);
+}
@@ -0,0 +1,293 @@
+#ifndef SPONGE_LIBSPONGE_TCP_STACK_HH
+#define SPONGE_LIBSPONGE_TCP_STACK_HH
+
+#include "connection_table.hh"
+#include "fastopen_cache.hh"
+#include "ipv4_datagram.hh"
+#include "port_allocator.hh"
+#include "ring_queue.hh"
+#include "siphash.hh"
+#include "tcp_config.hh"
+#include "tcp_connection.hh"
+#include "timer_wheel.hh"
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <queue>
+#include <string>
+#include <unordered_map>
+
+//! \brief Many TCP connections sharing one datagram path
+//! \details Inbound IPv4 datagrams are demultiplexed to their TCPConnection by FourTuple,
+//! and the segments that every connection sends are wrapped in IPv4 datagrams and merged
+//! onto one outbound queue. Each connection has one timer in a shared TimerWheel, armed at
+//! the connection's next deadline, so idle connections cost nothing per tick. With keepalive
+//! enabled (TCPConfig::keepalive_idle), the same timer sends the probes, and a connection whose
+//! peer has vanished is reset and removed.
+//!
+//! Like NetworkInterface and Router, the stack does no I/O itself: its owner moves datagrams
+//! between a datagram path (e.g. a TUN device) and datagram_received() / datagrams_out(), and
+//! calls tick() as time passes.
+//!
+//! Connections do not write to the outbound queue directly: each has its own egress queue, and an
+//! egress scheduler decides which of them goes next (strict priority between classes, deficit
+//! round-robin within a class, optional per-connection pacing and an optional rate for the whole
+//! path), so a bulk transfer cannot build a queue in front of an interactive one.
+class TCPStack {
+  public:
+    //! Number of egress priority classes; class 0 is served first
+    static constexpr uint8_t PRIORITY_CLASSES = 3;
+
+    //! Egress priority class of a connection unless set_priority() says otherwise
+    static constexpr uint8_t DEFAULT_PRIORITY = 1;
+
+    //! A connection that has stayed idle this long frees its queues (see TCPConnection::shrink_to_fit())
+    static constexpr uint64_t TRIM_DELAY_US = 1'000'000;
+
+  private:
+    //! \brief A connection and its bookkeeping
+    struct Connection {
+        FourTuple tuple;
+        TCPConnection tcp;
+        TimerWheel::TimerId timer{TimerWheel::NO_TIMER};
+        uint64_t last_tick_us{0};  //!< stack time when `tcp` was last ticked
+        bool embryonic{false};     //!< created by a listener and counted in its SYN backlog
+        //! stack time since which the connection has been idle, while its queues are still allocated
+        std::optional<uint64_t> idle_since_us{};
+        bool trimmed{false};  //!< idle, with its queues freed
+
+        //! datagrams waiting for the egress scheduler; starts small, since each empty slot holds a
+        //! default-constructed datagram, and most connections only ever queue a few
+        RingQueue<InternetDatagram> egress{4};
+        int64_t deficit{0};                    //!< bytes it may still send in this round-robin round
+        uint64_t pacing_rate{0};               //!< bytes per second, or 0 if not paced
+        uint64_t next_send_us{0};              //!< with pacing, the earliest stack time to send again
+        uint8_t priority{DEFAULT_PRIORITY};    //!< egress priority class
+        bool scheduled{false};                 //!< in the active list of a priority class
+
+        Connection(const FourTuple &t, const TCPConfig &cfg) : tuple(t), tcp(cfg) {}
+    };
+
+    //! \brief What is left of a connection in TIME_WAIT: enough to acknowledge the peer's FIN again
+    struct TimeWait {
+        WrappingInt32 seqno;  //!< our next sequence number (past our FIN)
+        WrappingInt32 ackno;  //!< the peer's next sequence number (past its FIN)
+        uint64_t expiry_us;   //!< stack time at which the record is removed
+    };
+
+    //! \brief A port that accepts incoming connections
+    struct Listener {
+        size_t backlog;                          //!< bound on both the SYN backlog and the accept queue
+        size_t syn_received{0};                  //!< connections that have not completed the handshake
+        std::queue<FourTuple> accept_queue{};    //!< connections that have, waiting for accept()
+        std::optional<uint64_t> last_cookie_epoch{};  //!< when a SYN cookie was last sent, if ever
+    };
+
+    //! SYN cookies are valid for the epoch they were sent in and the one after it
+    static constexpr uint64_t COOKIE_EPOCH_US = 64'000'000;
+
+    TCPConfig _cfg;
+
+    //! keyed hash that makes SYN cookies unforgeable
+    SipHash _cookie_hash{SipHash::with_random_key()};
+
+    //! keyed hash that makes Fast Open cookies unforgeable
+    SipHash _fastopen_hash{SipHash::with_random_key()};
+
+    //! listeners, by local port
+    std::unordered_map<uint16_t, Listener> _listeners{};
+
+    //! \note Connections are held by pointer: they are large, and a TCPConnection must not move
+    ConnectionTable<std::unique_ptr<Connection>> _connections{};
+
+    //! connections in TIME_WAIT, which keep no TCPConnection
+    ConnectionTable<TimeWait> _time_wait{};
+
+    //! (expiry, tuple) of TIME_WAIT records, in order of expiry; an entry whose expiry no longer
+    //! matches its record's (because the record was restarted or replaced) is skipped
+    std::queue<std::pair<uint64_t, FourTuple>> _time_wait_expiries{};
+
+    TimerWheel _timers;
+
+    //! source ports for connect_ephemeral()
+    PortAllocator _ports{};
+
+    //! outbound queue of IPv4 datagrams, from all connections
+    std::queue<InternetDatagram> _datagrams_out{};
+
+    //! bytes a connection may send each time it comes to the front of its active list
+    static constexpr int64_t EGRESS_QUANTUM = 1500;
+
+    //! most bytes the egress rate limit lets out at once after the path has been idle
+    static constexpr int64_t EGRESS_BURST = 16 * EGRESS_QUANTUM;
+
+    //! connections with datagrams in their egress queues, by priority class, in round-robin order
+    std::array<std::deque<FourTuple>, PRIORITY_CLASSES> _active{};
+
+    //! datagrams in the egress queues of all connections
+    size_t _egress_queued{0};
+
+    //! rate of the datagram path in bytes per second, or 0 if not limited
+    uint64_t _egress_rate{0};
+
+    //! bytes the rate limit lets out now (a token bucket), and the stack time it was last refilled
+    int64_t _egress_credit{EGRESS_BURST};
+    uint64_t _egress_credit_us{0};
+
+    //! time since the stack was started, in microseconds
+    uint64_t _now_us{0};
+
+    //! \returns the configuration of a new connection identified by `tuple`
+    TCPConfig connection_config(const FourTuple &tuple) const;
+
+    //! Create a connection (which must not exist yet) and its timer
+    Connection &add_connection(const FourTuple &tuple, const TCPConfig &cfg);
+
+    //! Remove a connection and its timer, saving its metrics (with TCPConfig::use_metrics_cache)
+    void remove(Connection &c);
+
+    //! \returns how long a connection stays in TIME_WAIT
+    uint64_t time_wait_us() const { return 10 * _cfg.initial_rto_us(); }
+
+    //! Replace a connection that has entered TIME_WAIT with a TimeWait record
+    void enter_time_wait(Connection &c);
+
+    //! Answer a segment for a connection in TIME_WAIT
+    void time_wait_segment_received(const FourTuple &tuple, const TCPSegment &seg, TimeWait &tw);
+
+    //! Remove the TIME_WAIT records that have expired
+    void expire_time_wait();
+
+    //! Tick a connection for the time that has passed since it was last ticked
+    void catch_up(Connection &c);
+
+    //! Create a connection for a SYN to a listening port, if the listener has room for it
+    void accept_syn(const FourTuple &tuple, const TCPSegment &seg, Listener &listener);
+
+    //! \returns the SYN cookie: the ISN of a SYN/ACK that answers `peer_isn` on `tuple` in `epoch`
+    WrappingInt32 syn_cookie(const FourTuple &tuple, const WrappingInt32 peer_isn, const uint64_t epoch) const;
+
+    //! \returns the Fast Open cookie this stack issues to clients at `remote_ip`
+    std::string fastopen_cookie(const uint32_t remote_ip) const;
+
+    //! Learn or forget a Fast Open cookie from the SYN/ACK of a connection we opened
+    void fastopen_syn_ack_received(const FourTuple &tuple, const TCPSegment &syn_ack);
+
+    //! Answer a SYN with a SYN/ACK whose ISN is a SYN cookie, without creating a connection
+    void send_syn_cookie(const FourTuple &tuple, const TCPSegment &syn, Listener &listener);
+
+    //! \brief Create a connection for an ACK that returns a valid SYN cookie
+    //! \returns `false` if the ACK should be answered with a RST
+    bool accept_cookie(const FourTuple &tuple, const TCPSegment &ack, Listener &listener);
+
+    //! Move a connection from its listener's SYN backlog to the accept queue once the handshake is over
+    void check_handshake(Connection &c);
+
+    //! Send a connection's output and re-arm its timer, or remove it if it is no longer active
+    void service(Connection &c);
+
+    //! Wrap a segment in an IPv4 datagram addressed by `tuple` and queue it for sending
+    void send_segment(const FourTuple &tuple, TCPSegment &seg);
+
+    //! Wrap a connection's segment in IPv4 datagrams and queue them for the egress scheduler
+    void send_segment(Connection &c, TCPSegment &seg);
+
+    //! \returns `true` if the egress rate limit lets a datagram out now
+    bool egress_credit() const { return _egress_rate == 0 or _egress_credit > 0; }
+
+    //! Move the datagrams that the egress scheduler lets out now to the outbound queue
+    void release_egress();
+
+    //! \returns microseconds until the egress scheduler can let another datagram out, if any is waiting
+    std::optional<uint64_t> egress_deadline_us() const;
+
+    //! Answer a segment that belongs to no connection with a RST, as a closed port does
+    void send_reset(const FourTuple &tuple, const TCPSegment &seg);
+
+  public:
+    //! \param[in] cfg the configuration of every connection
+    //! \param[in] timer_granularity_us the resolution of connection timers
+    explicit TCPStack(const TCPConfig &cfg, const uint64_t timer_granularity_us = 1000);
+
+    //! \brief Open a connection to `tuple`'s remote address and port, from its local ones
+    //! \details A connection in TIME_WAIT with the same tuple is replaced. With TCPConfig::fastopen
+    //! and a cookie for the remote address in FastOpenCache::global(), the SYN carries `data`;
+    //! otherwise `data` is sent once the handshake is done.
+    //! \returns the connection; the reference is valid until the connection has closed or entered
+    //! TIME_WAIT, and its inbound stream has been read to the end
+    TCPConnection &connect(const FourTuple &tuple, const std::string &data = {});
+
+    //! \brief Open a connection to `remote_ip`:`remote_port` from `local_ip` and an ephemeral port
+    //! \details The port is chosen by a PortAllocator among those with no connection to the same
+    //! destination; if there are none, a port whose connection is in TIME_WAIT is reused. `data`
+    //! is sent as by connect().
+    //! \returns the tuple of the new connection
+    FourTuple connect_ephemeral(const uint32_t local_ip,
+                                const uint32_t remote_ip,
+                                const uint16_t remote_port,
+                                const std::string &data = {});
+
+    //! \brief Accept connections to `local_port` (on any local address)
+    //! \param[in] local_port the port to listen on
+    //! \param[in] backlog the most connections that may be mid-handshake, and the most that may
+    //! wait for accept(); while the SYN backlog is full, SYNs are answered with SYN cookies, and
+    //! while the accept queue is full they are dropped, so the peer retries
+    //! \details With TCPConfig::fastopen, a SYN that asks for a Fast Open cookie gets one, and a SYN
+    //! that returns a valid cookie has its data delivered at once; its connection is ready for
+    //! accept() before the handshake completes.
+    void listen(const uint16_t local_port, const size_t backlog);
+
+    //! \brief Stop accepting connections to `local_port`; connections already accepted are unaffected
+    void close_listener(const uint16_t local_port);
+
+    //! \brief Take the next connection that has completed its handshake with `local_port`
+    //! \returns the connection's tuple (for connection() and update()), if any is waiting
+    std::optional<FourTuple> accept(const uint16_t local_port);
+
+    //! \returns the connection identified by `tuple`, or nullptr
+    TCPConnection *connection(const FourTuple &tuple);
+
+    //! \brief Send the output of a connection that has been used directly (e.g. written to or
+    //! shut down) and re-arm its timer
+    void update(const FourTuple &tuple);
+
+    //! \brief Put a connection in egress priority class `priority` (less than PRIORITY_CLASSES);
+    //! a class is served only while no class below it has a datagram ready
+    void set_priority(const FourTuple &tuple, const uint8_t priority);
+
+    //! \brief Pace a connection's datagrams to `bytes_per_second`, or stop pacing it if 0
+    void set_pacing_rate(const FourTuple &tuple, const uint64_t bytes_per_second);
+
+    //! \brief Limit the datagrams let out to `bytes_per_second`, the rate of the datagram path
+    //! (0, the default, for no limit), so that the queue builds up here, where it is scheduled
+    void set_egress_rate(const uint64_t bytes_per_second);
+
+    //! \brief Deliver an inbound IPv4 datagram to the connection it belongs to
+    void datagram_received(const InternetDatagram &dgram);
+
+    //! \brief Called periodically when time elapses
+    void tick(const size_t ms_since_last_tick) { tick_us(ms_since_last_tick * 1000); }
+
+    //! \brief Called periodically when time elapses, with microsecond resolution; runs the
+    //! timers of the connections that are due
+    void tick_us(const uint64_t us_since_last_tick);
+
+    //! \returns microseconds until tick_us() (or, for egress, datagrams_out()) next has something
+    //! to do, if any connection has a timer armed or a datagram waiting
+    std::optional<uint64_t> next_deadline_us() const;
+
+    //! \brief IPv4 datagrams that the connections have sent, for the owner to transmit, in the
+    //! order the egress scheduler lets them out
+    std::queue<InternetDatagram> &datagrams_out();
+
+    //! \returns the number of connections, not counting those in TIME_WAIT
+    size_t connection_count() const { return _connections.size(); }
+
+    //! \returns the number of connections in TIME_WAIT
+    size_t time_wait_count() const { return _time_wait.size(); }
+};
+
+#endif  // SPONGE_LIBSPONGE_TCP_STACK_HH
@@ -14,12 +14,36 @@ TCPOverIPv4OverEthernetAdapter::TCPOverIPv4OverEthernetAdapter(TapFD &&tap,
     // Linux seems to ignore the first frame sent on a TAP device, so send a dummy frame to prime the pump :-(
     EthernetFrame dummy_frame;
     _tap.write(dummy_frame.serialize());
+
+    // for read_batch() and send_pending()
+    _tap.set_blocking(false);
 }
 
 optional<TCPSegment> TCPOverIPv4OverEthernetAdapter::read() {
-    // Read Ethernet frame from the raw device
+    // Read Ethernet frame from the raw device (which is non-blocking)
+    string raw;
+    if (not _tap.try_read(raw)) {
+        return {};
+    }
+    return unwrap_tcp_in_frame(move(raw));
+}
+
+//! \param[out] segments receives the TCP segments, in arrival order
+//! \details Stops when the device has no frame waiting, or after MAX_READ_BATCH frames.
+void TCPOverIPv4OverEthernetAdapter::read_batch(vector<TCPSegment> &segments) {
+    string raw;
+    for (size_t i = 0; i < MAX_READ_BATCH and _tap.try_read(raw); i++) {
+        auto seg = unwrap_tcp_in_frame(move(raw));
+        if (seg) {
+            segments.push_back(move(seg.value()));
+        }
+    }
+}
+
+//! \param[in] raw an Ethernet frame read from the TAP device
+optional<TCPSegment> TCPOverIPv4OverEthernetAdapter::unwrap_tcp_in_frame(string &&raw) {
     EthernetFrame frame;
-    if (frame.parse(_tap.read()) != ParseResult::NoError) {
+    if (frame.parse(move(raw)) != ParseResult::NoError) {
         return {};
     }
 
@@ -36,23 +60,36 @@ optional<TCPSegment> TCPOverIPv4OverEthernetAdapter::read() {
     return {};
 }
 
-//! \param[in] ms_since_last_tick the number of milliseconds since the last call to this method
-void TCPOverIPv4OverEthernetAdapter::tick(const size_t ms_since_last_tick) {
-    _interface.tick(ms_since_last_tick);
+//! \param[in] us_since_last_tick the number of microseconds since the last call to this method
+void TCPOverIPv4OverEthernetAdapter::tick_us(const uint64_t us_since_last_tick) {
+    _interface.tick_us(us_since_last_tick);
     send_pending();
 }
 
 //! \param[in] seg the TCPSegment to send
-void TCPOverIPv4OverEthernetAdapter::write(TCPSegment &seg) {
-    _interface.send_datagram(wrap_tcp_in_ip(seg), _next_hop);
-    send_pending();
+bool TCPOverIPv4OverEthernetAdapter::write(TCPSegment &seg) {
+    if (_interface.frames_out().size() >= MAX_UNSENT) {
+        return false;
+    }
+    if (seg.gso_size() == 0) {
+        _interface.send_datagram(wrap_tcp_in_ip(seg), _next_hop);
+    } else {
+        for (auto &piece : seg.gso_split()) {
+            _interface.send_datagram(wrap_tcp_in_ip(piece), _next_hop);
+        }
+    }
+    return send_pending();
 }
 
-void TCPOverIPv4OverEthernetAdapter::send_pending() {
+//! \details A frame the device would not take stays at the front of the NetworkInterface's queue.
+bool TCPOverIPv4OverEthernetAdapter::send_pending() {
     while (not _interface.frames_out().empty()) {
-        _tap.write(_interface.frames_out().front().serialize());
+        if (not _tap.try_write(_interface.frames_out().front().serialize())) {
+            return false;
+        }
         _interface.frames_out().pop();
     }
+    return true;
 }
 
 //! Specialize LossyFdAdapter to TCPOverIPv4OverTunFdAdapter
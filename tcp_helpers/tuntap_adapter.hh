@@ -3,32 +3,100 @@
 
 #include "ethernet_header.hh"
 #include "network_interface.hh"
+#include "ring_queue.hh"
 #include "tun.hh"
 
 #include <optional>
+#include <string>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 //! \brief A FD adapter for IPv4 datagrams read from and written to a TUN device
 class TCPOverIPv4OverTunFdAdapter : public TCPOverIPv4Adapter {
   private:
     TunFD _tun;
 
+    //! IPv4 datagrams that the TUN device would not take without blocking, oldest first
+    RingQueue<BufferList> _unsent{};
+
+    //! Writes a datagram to the TUN device, or queues it behind the others (or drops it if the queue is full)
+    //! \returns `false` if it was queued or dropped
+    bool send(BufferList &&datagram) {
+        if (_unsent.empty() and _tun.try_write(datagram)) {
+            return true;
+        }
+        if (_unsent.size() < MAX_UNSENT) {
+            _unsent.push(std::move(datagram));
+        }
+        return false;
+    }
+
+    //! Parses an IPv4 datagram read from the TUN device and extracts its TCP segment, if related
+    std::optional<TCPSegment> unwrap_tcp_in_tun(std::string &&raw) {
+        InternetDatagram ip_dgram;
+        if (ip_dgram.parse(std::move(raw)) != ParseResult::NoError) {
+            return {};
+        }
+        return unwrap_tcp_in_ip(ip_dgram);
+    }
+
   public:
-    //! Construct from a TunFD
-    explicit TCPOverIPv4OverTunFdAdapter(TunFD &&tun) : _tun(std::move(tun)) {}
+    //! Construct from a TunFD (which is made non-blocking, for read_batch() and write())
+    explicit TCPOverIPv4OverTunFdAdapter(TunFD &&tun) : _tun(std::move(tun)) { _tun.set_blocking(false); }
 
     //! Attempts to read and parse an IPv4 datagram containing a TCP segment related to the current connection
+    //! \returns empty if the datagram was invalid or unrelated, or if none was waiting
     std::optional<TCPSegment> read() {
-        InternetDatagram ip_dgram;
-        if (ip_dgram.parse(_tun.read()) != ParseResult::NoError) {
+        std::string raw;
+        if (not _tun.try_read(raw)) {
             return {};
         }
-        return unwrap_tcp_in_ip(ip_dgram);
+        return unwrap_tcp_in_tun(std::move(raw));
     }
 
-    //! Creates an IPv4 datagram from a TCP segment and writes it to the TUN device
-    void write(TCPSegment &seg) { _tun.write(wrap_tcp_in_ip(seg).serialize()); }
+    //! Reads the datagrams already waiting on the TUN device, appending the related TCP segments to `segments`
+    void read_batch(std::vector<TCPSegment> &segments) {
+        std::string raw;
+        for (size_t i = 0; i < MAX_READ_BATCH and _tun.try_read(raw); i++) {
+            auto seg = unwrap_tcp_in_tun(std::move(raw));
+            if (seg) {
+                segments.push_back(std::move(seg.value()));
+            }
+        }
+    }
+
+    //! Creates an IPv4 datagram from a TCP segment (or each piece of a super-segment) and writes it to the TUN device
+    //! \returns `false` if the device would block, leaving (some of) the segment queued or, once the
+    //! queue is full, dropped
+    bool write(TCPSegment &seg) {
+        if (_unsent.size() >= MAX_UNSENT) {
+            return false;
+        }
+        if (seg.gso_size() == 0) {
+            return send(wrap_tcp_in_ip(seg).serialize());
+        }
+        bool sent = true;
+        for (auto &piece : seg.gso_split()) {
+            sent = send(wrap_tcp_in_ip(piece).serialize()) and sent;
+        }
+        return sent;
+    }
+
+    //! Writes the queued datagrams, while the TUN device takes them
+    //! \returns `true` if none is left
+    bool flush() {
+        while (not _unsent.empty()) {
+            if (not _tun.try_write(_unsent.front())) {
+                return false;
+            }
+            _unsent.pop();
+        }
+        return true;
+    }
+
+    //! \returns `true` if datagrams are queued, waiting for the TUN device to be writable
+    bool write_blocked() const { return not _unsent.empty(); }
 
     //! Access the underlying TUN device
     operator TunFD &() { return _tun; }
@@ -49,7 +117,12 @@ class TCPOverIPv4OverEthernetAdapter : public TCPOverIPv4Adapter {
 
     Address _next_hop;  //!< IP address of the next hop
 
-    void send_pending();  //!< Sends any pending Ethernet frames
+    //! Sends the pending Ethernet frames, while the TAP device takes them
+    //! \returns `true` if none is left
+    bool send_pending();
+
+    //! Gives a frame read from the TAP device to the NetworkInterface and extracts its TCP segment, if any
+    std::optional<TCPSegment> unwrap_tcp_in_frame(std::string &&raw);
 
   public:
     //! Construct from a TapFD
@@ -58,13 +131,35 @@ class TCPOverIPv4OverEthernetAdapter : public TCPOverIPv4Adapter {
                                             const Address &ip_address,
                                             const Address &next_hop);
     //! Attempts to read and parse an Ethernet frame containing an IPv4 datagram that contains a TCP segment
+    //! \returns empty if the frame did not carry a related TCP segment, or if none was waiting
     std::optional<TCPSegment> read();
 
+    //! Reads the frames already waiting on the TAP device, appending the related TCP segments to `segments`
+    void read_batch(std::vector<TCPSegment> &segments);
+
     //! Sends a TCP segment (in an IPv4 datagram, in an Ethernet frame).
-    void write(TCPSegment &seg);
+    //! \returns `false` if the device would block, leaving (some of) the frames pending or, once
+    //! MAX_UNSENT frames are pending, dropped
+    bool write(TCPSegment &seg);
+
+    //! Sends the pending Ethernet frames, while the TAP device takes them
+    //! \returns `true` if none is left
+    bool flush() { return send_pending(); }
+
+    //! \returns `true` if frames are pending, waiting for the TAP device to be writable
+    bool write_blocked() const { return not _interface.frames_out().empty(); }
 
     //! Called periodically when time elapses
-    void tick(const size_t ms_since_last_tick);
+    void tick(const size_t ms_since_last_tick) { tick_us(ms_since_last_tick * 1000); }
+
+    //! Called periodically when time elapses, with microsecond resolution
+    void tick_us(const uint64_t us_since_last_tick);
+
+    //! Milliseconds until the NetworkInterface next needs a tick
+    std::optional<size_t> next_deadline() const { return _interface.next_deadline(); }
+
+    //! Microseconds until the NetworkInterface next needs a tick
+    std::optional<uint64_t> next_deadline_us() const { return _interface.next_deadline_us(); }
 
     //! Access the underlying raw Ethernet connection
     operator TapFD &() { return _tap; }
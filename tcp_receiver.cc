@@ -9,10 +9,19 @@ bool TCPReceiver::segment_received(const TCPSegment &seg) {
     TCPHeader segment_header = seg.header();
     if(!is_syn_seen && !segment_header.syn)
         return false;
+    if(segment_header.syn && !_accept_syn_data && seg.payload().size() > 0)
+    {
+        //Data (and FIN) on a SYN that was not validated waits for the peer to send it again
+        TCPSegment syn;
+        syn.header() = segment_header;
+        syn.header().fin = false;
+        return segment_received(syn);
+    }
     if(!is_syn_seen)
     {
         is_syn_seen = true;
         _isn = segment_header.seqno;
+        _ackno = _isn + 1;
     }
     //Incoming segment start,end range
     uint64_t index_start = unwrap(segment_header.seqno, _isn, _checkpoint);
@@ -31,8 +40,22 @@ bool TCPReceiver::segment_received(const TCPSegment &seg) {
     uint64_t seqno_end = seqno_start + window_size() - 1;
     if(seqno_end < seqno_start)    //Window_size = 0
         seqno_end++;  
-    if((index_start >= seqno_start && index_start <= seqno_end )  || (payload_end >= seqno_start && index_end <=seqno_end) ) 
-        _reassembler.push_substring(seg.payload().copy(), index_start-1, segment_header.fin);
+    //Data on a SYN (TCP Fast Open) starts right after it
+    const uint64_t stream_index = index_start + (segment_header.syn ? 1 : 0) - 1;
+    if((index_start >= seqno_start && index_start <= seqno_end )  || (payload_end >= seqno_start && index_end <=seqno_end) ||
+            (segment_header.syn && !old_is_syn_seen))
+    {
+        //Keep only what fits in the window, so a peer that ignores it cannot fill the buffer to its maximum
+        const uint64_t window_end = _reassembler.stream_out().bytes_written() + window_size();
+        Buffer payload = seg.payload();
+        bool eof = segment_header.fin;
+        if(stream_index + payload.size() > window_end)
+        {
+            payload.remove_suffix(stream_index + payload.size() - max(window_end, stream_index));
+            eof = false;
+        }
+        _reassembler.push_substring(payload.copy(), stream_index, eof);
+    }
 
     _checkpoint = _reassembler.stream_out().bytes_written();
     if(!is_fin_seen && segment_header.fin)
@@ -43,7 +66,7 @@ bool TCPReceiver::segment_received(const TCPSegment &seg) {
     }
     if( payload_end <= _checkpoint )
     {
-        _ackno =  wrap(_reassembler.stream_out().bytes_written() + (is_fin_seen && (_reassembler.unassembled_bytes()==0)?1:0) +1, _isn);
+        _ackno =  wrap(_reassembler.stream_out().bytes_written() + (_reassembler.stream_out().input_ended()?1:0) +1, _isn);
     }
     else if(seg.length_in_sequence_space()!=0)
     {
@@ -53,14 +76,76 @@ bool TCPReceiver::segment_received(const TCPSegment &seg) {
     if((index_start >= seqno_start && index_start <= seqno_end )  || (index_end >= seqno_start && index_end <=seqno_end) ||
             //Reject second SYN or second FIN
             (segment_header.fin && !old_is_fin_seen) || (segment_header.syn && !old_is_syn_seen)) 
+    {
+        record_right_edge();
         return true;
+    }
+    record_right_edge();
     return false;
 }
 
+//! \param[in] seqno the sequence number of the segment
+//! \param[in] payload the (non-empty) payload of a segment with only the ACK (and maybe PSH) flag set
+bool TCPReceiver::predicted_segment_received(const WrappingInt32 seqno, const Buffer &payload) {
+    if(!is_syn_seen || is_fin_seen || seqno!=_ackno || _reassembler.unassembled_bytes()!=0 || payload.size() > window_size())
+        return false;
+    ByteStream &stream = _reassembler.stream_out();
+    _reassembler.push_substring(payload.copy(), stream.bytes_written(), false);
+    _checkpoint = stream.bytes_written();
+    _ackno = wrap(_checkpoint + 1, _isn);
+    record_right_edge();
+    return true;
+}
+
 optional<WrappingInt32> TCPReceiver::ackno() const { 
     if(is_syn_seen)
         return _ackno ;
     return {};
  }
 
-size_t TCPReceiver::window_size() const { return _capacity - _reassembler.stream_out().buffer_size(); }
+//! \details While the global MemoryBudget is exhausted, the window does not open past the right
+//! edge already promised until the application has drained the buffer, and then only by one
+//! segment, so that the connection still makes progress.
+size_t TCPReceiver::window_size() const {
+    const ByteStream &stream = _reassembler.stream_out();
+    uint64_t open_edge = stream.bytes_read() + _capacity;
+    if(MemoryBudget::global().exhausted())
+    {
+        const bool drained = stream.buffer_empty() && _reassembler.unassembled_bytes() == 0;
+        open_edge = stream.bytes_written() + (drained ? min(_capacity, TCPConfig::MAX_PAYLOAD_SIZE) : 0);
+    }
+    const uint64_t right_edge = max(_right_edge_floor, open_edge);
+    return (right_edge > stream.bytes_written()) ? (right_edge - stream.bytes_written()) : 0;
+}
+
+//! \param[in] us_since_last_tick the number of microseconds since the last call to this method
+//! \details Once per RTT, compares the bytes consumed by the application with the
+//! capacity (like Linux's tcp_rcv_space_adjust); a buffer that is drained by more than
+//! half every RTT is limiting throughput, so it is grown to twice the consumption.
+//! While the global MemoryBudget is under pressure, the buffer shrinks back and does not grow.
+void TCPReceiver::tick_us(const uint64_t us_since_last_tick) {
+    _time_alive += us_since_last_tick;
+    const bool pressure = MemoryBudget::global().under_pressure();
+    if(pressure)
+        memory_pressure();
+    if(_time_alive - _space_time < _rtt_estimate)
+        return;
+    const uint64_t bytes_read = _reassembler.stream_out().bytes_read();
+    const uint64_t copied = bytes_read - _space_bytes_read;
+    if(is_syn_seen && !pressure && 2 * copied > _capacity)
+        _capacity = min(_max_capacity, static_cast<size_t>(2 * copied));
+    _space_time = _time_alive;
+    _space_bytes_read = bytes_read;
+}
+
+void TCPReceiver::memory_pressure() {
+    if(_capacity <= _initial_capacity)
+        return;
+    _right_edge_floor = max(_right_edge_floor, _reassembler.stream_out().bytes_read() + _capacity);
+    _capacity = _initial_capacity;
+}
+
+void TCPReceiver::record_right_edge() {
+    if(!MemoryBudget::global().exhausted())
+        _right_edge_floor = max(_right_edge_floor, _reassembler.stream_out().bytes_read() + _capacity);
+}
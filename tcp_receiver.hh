@@ -3,9 +3,11 @@
 
 #include "byte_stream.hh"
 #include "stream_reassembler.hh"
+#include "tcp_config.hh"
 #include "tcp_segment.hh"
 #include "wrapping_integers.hh"
 
+#include <algorithm>
 #include <optional>
 
 //! \brief The "receiver" part of a TCP implementation.
@@ -20,18 +22,51 @@ class TCPReceiver {
     //! The maximum number of bytes we'll store.
     size_t _capacity;
 
+    //! Capacity at construction; the receive buffer shrinks back to it under memory pressure
+    size_t _initial_capacity;
+
+    //! Upper bound for auto-tuning of `_capacity`
+    size_t _max_capacity;
+
+    //! Take the data on the peer's SYN (a validated Fast Open SYN); otherwise it is dropped
+    bool _accept_syn_data;
+
+    //! Stream index of the right window edge already promised to the peer when the capacity shrank
+    uint64_t _right_edge_floor{0};
+
+    //! time alive since TCP receiver was started, in microseconds. Updated when tick_us() is called
+    uint64_t _time_alive{0};
+
+    //! start time and stream bytes read at the start of the current auto-tuning measurement
+    uint64_t _space_time{0};
+    uint64_t _space_bytes_read{0};
+
+    //! round-trip time estimate over which application consumption is measured, in microseconds
+    uint64_t _rtt_estimate{TCPConfig::TIMEOUT_DFLT * uint64_t{1000}};
+
     WrappingInt32 _isn{0};
     bool is_syn_seen{false};
     bool is_fin_seen{false};
     uint64_t _checkpoint{0};
     WrappingInt32 _ackno{0};
+
+    //! Raise `_right_edge_floor` to the right edge of the window being advertised, so that it is
+    //! kept if the memory budget runs out
+    void record_right_edge();
     
   public:
     //! \brief Construct a TCP receiver
     //!
     //! \param capacity the maximum number of bytes that the receiver will
     //!                 store in its buffers at any give time.
-    TCPReceiver(const size_t capacity) : _reassembler(capacity), _capacity(capacity) {}
+    //! \param max_capacity the capacity that auto-tuning may grow the receive buffer to
+    //! \param accept_syn_data whether to take the data on the peer's SYN (see TCPConfig::accept_syn_data)
+    TCPReceiver(const size_t capacity, const size_t max_capacity = 0, const bool accept_syn_data = false)
+        : _reassembler(std::max(capacity, max_capacity))
+        , _capacity(capacity)
+        , _initial_capacity(capacity)
+        , _max_capacity(std::max(capacity, max_capacity))
+        , _accept_syn_data(accept_syn_data) {}
 
     //! \name Accessors to provide feedback to the remote TCPSender
     //!@{
@@ -47,7 +82,8 @@ class TCPReceiver {
     //!
     //! Operationally: the capacity minus the number of bytes that the
     //! TCPReceiver is holding in its byte stream (those that have been
-    //! reassembled, but not consumed).
+    //! reassembled, but not consumed). If the capacity has shrunk, the window
+    //! closes only as the application reads, so its right edge never moves back.
     //!
     //! Formally: the difference between (a) the sequence number of
     //! the first byte that falls after the window (and will not be
@@ -59,15 +95,43 @@ class TCPReceiver {
     //! \brief number of bytes stored but not yet reassembled
     size_t unassembled_bytes() const { return _reassembler.unassembled_bytes(); }
 
+    //! \brief current capacity of the receive buffer
+    size_t capacity() const { return _capacity; }
+
+    //! \name Receive-buffer auto-tuning
+    //!@{
+
+    //! \brief Set the round-trip time (in microseconds) over which application consumption is measured
+    void set_rtt_estimate_us(const uint64_t rtt_us) { _rtt_estimate = std::max(rtt_us, static_cast<uint64_t>(1)); }
+
+    //! \brief Notifies the TCPReceiver of the passage of time, in microseconds; grows the capacity
+    //! toward its maximum when the application consumes more than half of it per RTT
+    void tick_us(const uint64_t us_since_last_tick);
+
+    //! \brief Shrink the capacity back to its initial value without retracting the advertised window
+    void memory_pressure();
+
+    //! \brief Start from the capacity that an earlier connection auto-tuned to (within this one's bounds)
+    void warm_start(const size_t capacity) { _capacity = std::clamp(capacity, _initial_capacity, _max_capacity); }
+    //!@}
+
     //! \brief handle an inbound segment
     //! \returns `true` if any part of the segment was inside the window
     bool segment_received(const TCPSegment &seg);
 
+    //! \brief Header-prediction fast path for the next in-order payload
+    //! \returns `false` (and changes nothing) unless the receiver is in the data phase with nothing
+    //! waiting to be reassembled, `seqno` is the ackno and the payload fits in the window
+    bool predicted_segment_received(const WrappingInt32 seqno, const Buffer &payload);
+
     //! \name "Output" interface for the reader
     //!@{
     ByteStream &stream_out() { return _reassembler.stream_out(); }
     const ByteStream &stream_out() const { return _reassembler.stream_out(); }
     //!@}
+
+    //! \brief Bytes of heap storage held by the receiver
+    size_t memory_usage() const { return _reassembler.memory_usage(); }
 };
 
 #endif  // SPONGE_LIBSPONGE_TCP_RECEIVER_HH
@@ -1,23 +1,49 @@
 #include "tcp_sender.hh"
 
+#include "isn_generator.hh"
 #include "tcp_config.hh"
 
-#include <random>
-
 // passes automated checks run by `make check_lab3`.
 
 
 
 //! \param[in] capacity the capacity of the outgoing byte stream
-//! \param[in] retx_timeout the initial amount of time to wait before retransmitting the oldest outstanding segment
-//! \param[in] fixed_isn the Initial Sequence Number to use, if set (otherwise uses a random ISN)
+//! \param[in] retx_timeout the initial amount of time to wait before retransmitting the oldest outstanding segment, in milliseconds
+//! \param[in] fixed_isn the Initial Sequence Number to use, if set (otherwise an unpredictable one from ISNGenerator)
 TCPSender::TCPSender(const size_t capacity, const uint16_t retx_timeout, const std::optional<WrappingInt32> fixed_isn)
-    : _isn(fixed_isn.value_or(WrappingInt32{random_device()()}))
-    , _initial_retransmission_timeout{retx_timeout}
-    , _stream(capacity) { 
+    : _isn(fixed_isn.has_value() ? fixed_isn.value() : ISNGenerator::global().isn())
+    , _initial_retransmission_timeout{retx_timeout * uint64_t{1000}}
+    , _stream(capacity)
+    , _min_capacity(capacity)
+    , _max_capacity(capacity) { 
     _current_retransmission_timeout = _initial_retransmission_timeout;
     }
 
+//! \param[in] cfg the configuration; the send buffer is auto-sized between
+//! `cfg.send_capacity` and `cfg.send_capacity_max`
+TCPSender::TCPSender(const TCPConfig &cfg) : TCPSender(cfg.send_capacity, cfg.rt_timeout, cfg.fixed_isn) {
+    _max_capacity = max(cfg.send_capacity, cfg.send_capacity_max);
+    _initial_retransmission_timeout = _current_retransmission_timeout = cfg.initial_rto_us();
+    if(cfg.gso)
+        _max_payload_size = TCPConfig::GSO_MAX_PAYLOAD_SIZE;
+    _fastopen_cookie = cfg.fastopen_cookie;
+    if(cfg.metrics.has_value() && cfg.metrics->srtt_us > 0)
+    {
+        // warm start from an earlier connection: its RTT estimates, an RTO computed from them
+        // (RFC 6298, section 2.3) but no shorter than MIN_RTO_US and no longer than configured,
+        // and its peer's window; the RTO is never re-estimated, so it must allow for RTT jitter
+        _srtt = cfg.metrics->srtt_us;
+        _rttvar = cfg.metrics->rttvar_us;
+        const uint64_t rto = max(_srtt + 4 * _rttvar, static_cast<uint64_t>(TCPConfig::MIN_RTO_US));
+        _initial_retransmission_timeout = _current_retransmission_timeout = min(_initial_retransmission_timeout, rto);
+        if(_max_capacity > _min_capacity)
+        {
+            const size_t target = min(_max_capacity, static_cast<size_t>(TCPConfig::SEND_BUFFER_WINDOWS * cfg.metrics->peer_window));
+            _stream.set_capacity(max(_min_capacity, target));
+        }
+    }
+}
+
 uint64_t TCPSender::bytes_in_flight() const { 
     uint64_t bytes_in_flight  = _next_seqno;
     if(_ack_seen)
@@ -26,31 +52,48 @@ uint64_t TCPSender::bytes_in_flight() const {
  }
 
 
+//! \details With a Fast Open cookie, the SYN also carries as much of the stream as fits in one
+//! segment next to the option, before the peer has announced a window (RFC 7413, section 4.2.1).
+//! Nothing is sent while the output is blocked; the owner fills the window again once it is not.
 void TCPSender::fill_window() {
+    if(_output_blocked)
+        return;
     if(!_is_syn_sent)
     {
         TCPSegment syn_seg;
         syn_seg.header().seqno = next_seqno();
         syn_seg.header().syn = true;
-        _segments_out.push(syn_seg);
         _next_seqno++;
         _is_syn_sent = true;
-        _retransmission_queue.push(syn_seg);
-        if(!_timer_on)
+        if(_fastopen_cookie.has_value())
         {
-            _timer_expiry = _time_alive + _current_retransmission_timeout;
-            _timer_on = true;
+            syn_seg.header().fastopen = true;
+            syn_seg.header().fastopen_cookie = move(_fastopen_cookie.value());
+            _fastopen_cookie.reset();
+            // leave room for the longest option: kind, length and cookie, padded to 4 bytes
+            const size_t syn_payload_max = TCPConfig::MAX_PAYLOAD_SIZE - (TCPHeader::FASTOPEN_COOKIE_MAX + 4);
+            const size_t payload_size = syn_seg.header().fastopen_cookie.empty() ? 0 : min(_stream.buffer_size(), syn_payload_max);
+            if(payload_size > 0)
+            {
+                syn_seg.payload() = Buffer(_stream.read(payload_size));
+                _checkpoint = _stream.bytes_read();
+                _next_seqno += payload_size;
+            }
         }
+        send_segment(move(syn_seg));
     }
     while(!_stream.buffer_empty() && (bytes_in_flight() < _window_size  || !_window_size))
     {
         TCPSegment tseg;
         tseg.header().seqno = next_seqno();
         //Zero window probing
-        size_t payload_size = min(TCPConfig::MAX_PAYLOAD_SIZE, min(_stream.buffer_size(), max(static_cast<uint64_t>(1),_window_size) - bytes_in_flight()));
+        size_t payload_size = min(_max_payload_size, min(_stream.buffer_size(), max(static_cast<uint64_t>(1),_window_size) - bytes_in_flight()));
         if(payload_size==0)
             break;
         tseg.payload() = Buffer(_stream.read(payload_size));
+        //Super-segment: the adapter splits it into MSS-sized segments
+        if(payload_size > TCPConfig::MAX_PAYLOAD_SIZE)
+            tseg.set_gso_size(TCPConfig::MAX_PAYLOAD_SIZE);
         _checkpoint = _stream.bytes_read();
         _next_seqno+=payload_size;
         if(_stream.eof() && bytes_in_flight()< _window_size && !_is_fin_sent)
@@ -60,13 +103,7 @@ void TCPSender::fill_window() {
             _is_fin_sent = true;
             
         }
-        _segments_out.push(tseg);
-        _retransmission_queue.push(tseg);
-        if(!_timer_on)
-        {
-            _timer_expiry = _time_alive + _current_retransmission_timeout;
-            _timer_on = true;
-        }
+        send_segment(move(tseg));
         if(_window_size==0)//Zero window probing
             break;
     }
@@ -75,15 +112,9 @@ void TCPSender::fill_window() {
         TCPSegment fin_seg;
         fin_seg.header().seqno = next_seqno();
         fin_seg.header().fin = true;
-        _segments_out.push(fin_seg);
         _next_seqno++;
-        _retransmission_queue.push(fin_seg);
         _is_fin_sent = true;
-        if(!_timer_on)
-        {
-            _timer_expiry = _time_alive + _current_retransmission_timeout;
-            _timer_on = true;
-        }
+        send_segment(move(fin_seg));
     }
     _max_seqno = max(_max_seqno, _next_seqno - 1);
         
@@ -95,65 +126,206 @@ void TCPSender::fill_window() {
 //! \returns `false` if the ackno appears invalid (acknowledges something the TCPSender hasn't sent yet)
 bool TCPSender::ack_received(const WrappingInt32 ackno, const uint16_t window_size) {
     _window_size = static_cast<size_t>(window_size);
+    update_stream_capacity();
     uint64_t abs_ackno = unwrap(ackno, _isn, _checkpoint);
     if(abs_ackno<=_max_seqno_acked)
         return true;
-    uint64_t queue_front_seqno = (!_retransmission_queue.empty()) ? unwrap(_retransmission_queue.front().header().seqno, _isn, _checkpoint) : 0;
     if(abs_ackno<=_max_seqno+1)
     {
-        _ack_seen = true;
-        _max_seqno_acked = max(_max_seqno_acked, abs_ackno);
-        while(!_retransmission_queue.empty() && queue_front_seqno < abs_ackno)
+        acknowledge(abs_ackno);
+        return true;
+    }
+    return false;
+}
+
+//! \param ackno The remote receiver's ackno, which must be the expected header-prediction case:
+//! it advances snd_una without passing next_seqno(), on a connection whose SYN has been acknowledged,
+//! and arrives with an unchanged window (so neither unwrap() nor buffer resizing is needed)
+//! \returns `false` (and changes nothing) if the ackno is not the predicted case
+bool TCPSender::predicted_ack_received(const WrappingInt32 ackno) {
+    const int32_t newly_acked = ackno - unacked_seqno();
+    if(newly_acked <= 0 || next_seqno() - ackno < 0 || !syn_acked())
+        return false;
+    acknowledge(_max_seqno_acked + newly_acked);
+    return true;
+}
+
+//! \param abs_ackno a valid (absolute) ackno that acknowledges new data
+void TCPSender::acknowledge(const uint64_t abs_ackno) {
+    _ack_seen = true;
+    _max_seqno_acked = max(_max_seqno_acked, abs_ackno);
+    if(_rtt_timing && abs_ackno >= _rtt_seqno)
+    {
+        // RFC 6298 section 2
+        const uint64_t rtt = _time_alive - _rtt_start;
+        if(_srtt==0)
         {
-            _retransmission_queue.pop();
-            if(!_retransmission_queue.empty())
-                queue_front_seqno = unwrap(_retransmission_queue.front().header().seqno, _isn, _checkpoint);
-            else
-                break;
+            _srtt = max(rtt, static_cast<uint64_t>(1));
+            _rttvar = rtt / 2;
         }
-        _current_retransmission_timeout = _initial_retransmission_timeout;
-        if(!_retransmission_queue.empty())
+        else
         {
-            _timer_on = true;
-            _timer_expiry = _time_alive + _current_retransmission_timeout;
+            const uint64_t delta = (_srtt > rtt) ? (_srtt - rtt) : (rtt - _srtt);
+            _rttvar = (3 * _rttvar + delta) / 4;
+            _srtt = max((7 * _srtt + rtt) / 8, static_cast<uint64_t>(1));
         }
-        else
-            _timer_on = false;
-        _consecutive_retransmissions = 0;
-        return true;
+        _rtt_timing = false;
     }
-    return false;
+    while(!_retransmission_queue.empty() && _retransmission_queue.front().end() <= abs_ackno)
+    {
+        _outstanding_charge.set(_outstanding_charge.bytes() - _retransmission_queue.front().payload.size());
+        _retransmission_queue.pop();
+    }
+    //Trim a partially acknowledged segment in place, so only its unacknowledged tail is retransmitted
+    bool syn_data_refused = false;
+    if(!_retransmission_queue.empty() && _retransmission_queue.front().seqno < abs_ackno)
+    {
+        OutstandingSegment &front = _retransmission_queue.front();
+        if(front.syn)
+        {
+            front.syn = false;
+            front.seqno++;
+            syn_data_refused = (abs_ackno == front.seqno);
+        }
+        front.payload.remove_prefix(abs_ackno - front.seqno);
+        _outstanding_charge.set(_outstanding_charge.bytes() - (abs_ackno - front.seqno));
+        front.seqno = abs_ackno;
+    }
+    _current_retransmission_timeout = _initial_retransmission_timeout;
+    if(!_retransmission_queue.empty())
+    {
+        _timer_on = true;
+        _timer_expiry = _time_alive + _current_retransmission_timeout;
+    }
+    else
+        _timer_on = false;
+    _consecutive_retransmissions = 0;
+    // the peer acknowledged a Fast Open SYN but not its data: send the data now (RFC 7413, section 4.2.2)
+    if(syn_data_refused)
+        _segments_out.push(retransmission_segment());
 }
 
-//! \param[in] ms_since_last_tick the number of milliseconds since the last call to this method
-void TCPSender::tick(const size_t ms_since_last_tick) { 
-    _time_alive += ms_since_last_tick ;
+//! \param[in] us_since_last_tick the number of microseconds since the last call to this method
+void TCPSender::tick_us(const uint64_t us_since_last_tick) { 
+    _time_alive += us_since_last_tick ;
     if(_retransmission_queue.empty())
         return;
     if(_time_alive < _timer_expiry || !_timer_on)
         return;
-    while(!_retransmission_queue.empty())
+    // Karn's algorithm: never take an RTT sample from a retransmitted segment
+    _rtt_timing = false;
+    _segments_out.push(retransmission_segment());
+    if(_window_size!=0)
     {
-        _segments_out.push(_retransmission_queue.front());
-        if(_window_size!=0)
-        {
-            _current_retransmission_timeout*=2;
-            _consecutive_retransmissions++;
-        }
-        _timer_expiry = _time_alive + _current_retransmission_timeout;
-        break;
-        _retransmission_queue.pop();
+        _current_retransmission_timeout*=2;
+        _consecutive_retransmissions++;
     }
-    if(_retransmission_queue.empty())
-        _timer_on = false;
-    
+    _timer_expiry = _time_alive + _current_retransmission_timeout;
  }
 
+std::optional<size_t> TCPSender::next_deadline() const {
+    const auto deadline = next_deadline_us();
+    if(!deadline.has_value())
+        return {};
+    return (deadline.value() + 999) / 1000;
+}
+
+std::optional<uint64_t> TCPSender::next_deadline_us() const {
+    if(!_timer_on || _retransmission_queue.empty())
+        return {};
+    return (_timer_expiry > _time_alive) ? (_timer_expiry - _time_alive) : 0;
+}
+
+//! \details Starts at the oldest outstanding range and appends the following ranges while the
+//! payload still fits in TCPConfig::MAX_PAYLOAD_SIZE, so a run of small lost segments goes out as
+//! one full-sized segment. A single range reuses its payload storage; merging ranges copies.
+//! Zero-window probes and ranges that carry a SYN or FIN are never merged (so a retransmitted SYN
+//! or FIN keeps the length it was sent with), and a range sent as a super-segment is resent one
+//! MSS at a time.
+TCPSegment TCPSender::retransmission_segment() const {
+    const OutstandingSegment &front = _retransmission_queue.front();
+    TCPSegment seg;
+    seg.header().seqno = wrap(front.seqno, _isn);
+    seg.header().syn = front.syn;
+    seg.header().fin = front.fin;
+    seg.payload() = front.payload;
+    if(front.payload.size() > TCPConfig::MAX_PAYLOAD_SIZE)
+    {
+        seg.payload().remove_suffix(front.payload.size() - TCPConfig::MAX_PAYLOAD_SIZE);
+        seg.header().fin = false;
+        return seg;
+    }
+    if(front.syn || front.fin || _window_size==0 || _retransmission_queue.size()==1)
+        return seg;
+
+    string payload = front.payload.copy();
+    for(size_t i = 1; i < _retransmission_queue.size(); i++)
+    {
+        const OutstandingSegment &next = _retransmission_queue[i];
+        if(next.syn || next.fin || payload.size() + next.payload.size() > TCPConfig::MAX_PAYLOAD_SIZE)
+            break;
+        payload.append(next.payload.str());
+    }
+    seg.payload() = Buffer(move(payload));
+    return seg;
+}
+
+
+size_t TCPSender::memory_usage() const {
+    return _stream.memory_usage() + _segments_out.capacity() * sizeof(TCPSegment)
+         + _retransmission_queue.capacity() * sizeof(OutstandingSegment) + _outstanding_charge.bytes();
+}
+
+void TCPSender::shrink_to_fit() {
+    _stream.shrink_to_fit();
+    _segments_out.shrink_to_fit();
+    _retransmission_queue.shrink_to_fit();
+}
 
 unsigned int TCPSender::consecutive_retransmissions() const { return _consecutive_retransmissions; }
 
+//! \param[in] seg a segment occupying sequence numbers up to (but not including) _next_seqno
+void TCPSender::send_segment(TCPSegment &&seg) {
+    _retransmission_queue.push({_next_seqno - seg.length_in_sequence_space(), seg.header().syn, seg.header().fin, seg.payload()});
+    _outstanding_charge.set(_outstanding_charge.bytes() + seg.payload().size());
+    _segments_out.push(move(seg));
+    if(!_timer_on)
+    {
+        _timer_expiry = _time_alive + _current_retransmission_timeout;
+        _timer_on = true;
+    }
+    if(!_rtt_timing)
+    {
+        _rtt_timing = true;
+        _rtt_seqno = _next_seqno;
+        _rtt_start = _time_alive;
+    }
+}
+
+//! \details A bulk sender needs about one window in flight plus one queued behind it to keep
+//! the pipe full, so the buffer follows the larger of the peer's window and the bytes in flight,
+//! bounded by the configured limits. It never shrinks below what is already buffered, and does
+//! not grow while the global MemoryBudget is under pressure.
+void TCPSender::update_stream_capacity() {
+    if(_max_capacity <= _min_capacity)
+        return;
+    const uint64_t window = max(_window_size, static_cast<uint64_t>(bytes_in_flight()));
+    size_t target = min(_max_capacity, static_cast<size_t>(TCPConfig::SEND_BUFFER_WINDOWS * window));
+    if(MemoryBudget::global().under_pressure())
+        target = _min_capacity;
+    _stream.set_capacity(max(max(_min_capacity, target), _stream.buffer_size()));
+}
+
+//! \details The probe's sequence number is one before next_seqno(), which the peer has already
+//! acknowledged, so the peer answers it with an ACK (RFC 1122, section 4.2.3.6)
+void TCPSender::send_keepalive_probe() {
+    TCPSegment probe;
+    probe.header().seqno = next_seqno() - 1;
+    _segments_out.push(move(probe));
+}
+
 void TCPSender::send_empty_segment() {
     TCPSegment empty;
     empty.header().seqno = next_seqno();
-    _segments_out.push(empty);
+    _segments_out.push(move(empty));
 }
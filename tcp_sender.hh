@@ -2,12 +2,14 @@
 #define SPONGE_LIBSPONGE_TCP_SENDER_HH
 
 #include "byte_stream.hh"
+#include "memory_budget.hh"
+#include "ring_queue.hh"
 #include "tcp_config.hh"
 #include "tcp_segment.hh"
 #include "wrapping_integers.hh"
 
 #include <functional>
-#include <queue>
+#include <optional>
 
 //! \brief The "sender" part of a TCP implementation.
 
@@ -21,14 +23,21 @@ class TCPSender {
     WrappingInt32 _isn;
 
     //! outbound queue of segments that the TCPSender wants sent
-    std::queue<TCPSegment> _segments_out{};
+    RingQueue<TCPSegment> _segments_out{8};
 
-    //! retransmission timer for the connection
-    unsigned int _initial_retransmission_timeout;
+    //! initial retransmission timeout for the connection, in microseconds
+    uint64_t _initial_retransmission_timeout;
 
     //! outgoing stream of bytes that have not yet been sent
     ByteStream _stream;
 
+    //! largest payload of a new segment; above TCPConfig::MAX_PAYLOAD_SIZE with segmentation offload
+    size_t _max_payload_size{TCPConfig::MAX_PAYLOAD_SIZE};
+
+    //! bounds for auto-sizing the capacity of `_stream`
+    size_t _min_capacity;
+    size_t _max_capacity;
+
     //! the (absolute) sequence number for the next byte to be sent
     uint64_t _next_seqno{0};
 
@@ -48,14 +57,38 @@ class TCPSender {
     bool _is_syn_sent{};
     bool _is_fin_sent{};
 
-    //! time alive since TCP sender was started. Updated when tick() is called
-    size_t _time_alive{0};
+    //! Fast Open option for the SYN, until the SYN is sent
+    std::optional<std::string> _fastopen_cookie{};
+
+    //! time alive since TCP sender was started, in microseconds. Updated when tick() is called
+    uint64_t _time_alive{0};
+
+    //! the device below would block, so new data waits in `_stream`
+    bool _output_blocked{false};
+
+    //! \brief A range of sequence space that has been sent but not yet acknowledged
+    struct OutstandingSegment
+    {
+        uint64_t seqno{0};  //!< absolute sequence number of the SYN, or else of the first payload byte
+        bool syn{false};
+        bool fin{false};
+        Buffer payload{};  //!< shares its storage with the payload of the segment that was sent
 
-    //! queue for Potential Retransmission of Segments
-    queue<TCPSegment > _retransmission_queue{};
+        //! absolute sequence number just past this range
+        uint64_t end() const { return seqno + (syn ? 1 : 0) + payload.size() + (fin ? 1 : 0); }
+    };
 
-    //! current retransmission timer timeout
-    unsigned int _current_retransmission_timeout{};
+    //! outstanding ranges for potential retransmission, ordered by (absolute) sequence number
+    RingQueue<OutstandingSegment> _retransmission_queue{8};
+
+    //! the payload bytes of `_retransmission_queue`, charged to the global MemoryBudget
+    MemoryCharge _outstanding_charge{};
+
+    //! build a retransmission of the oldest outstanding data, filled up to one MSS
+    TCPSegment retransmission_segment() const;
+
+    //! current retransmission timer timeout, in microseconds
+    uint64_t _current_retransmission_timeout{};
 
     //! number of consecutive transmissions because of retransmission timer timeout
     unsigned int _consecutive_retransmissions{};
@@ -64,11 +97,32 @@ class TCPSender {
     bool _timer_on{false};
 
     //! time at which retransmission timer expires
-    unsigned int _timer_expiry{};
+    uint64_t _timer_expiry{};
 
     //! proper ACK seen atleast once
     bool _ack_seen{false};
-    
+
+    //! is a segment being timed for an RTT sample
+    bool _rtt_timing{false};
+
+    //! (absolute) sequence number whose acknowledgment completes the RTT sample
+    uint64_t _rtt_seqno{0};
+
+    //! time at which the timed segment was sent
+    uint64_t _rtt_start{0};
+
+    //! smoothed round-trip time and its variation (RFC 6298), in microseconds
+    uint64_t _srtt{0};
+    uint64_t _rttvar{0};
+
+    //! push a new segment to the outbound and retransmission queues and arm the timer
+    void send_segment(TCPSegment &&seg);
+
+    //! resize `_stream` to a multiple of the peer's window (or the bytes in flight)
+    void update_stream_capacity();
+
+    //! retire everything below a valid (absolute) ackno and restart the retransmission timer
+    void acknowledge(const uint64_t abs_ackno);
 
 
   public:
@@ -77,6 +131,9 @@ class TCPSender {
               const uint16_t retx_timeout = TCPConfig::TIMEOUT_DFLT,
               const std::optional<WrappingInt32> fixed_isn = {});
 
+    //! Initialize a TCPSender from a configuration
+    explicit TCPSender(const TCPConfig &cfg);
+
     //! \name "Input" interface for the writer
     //!@{
     ByteStream &stream_in() { return _stream; }
@@ -89,14 +146,33 @@ class TCPSender {
     //! \brief A new acknowledgment was received
     bool ack_received(const WrappingInt32 ackno, const uint16_t window_size);
 
+    //! \brief Header-prediction fast path for an ACK that only advances snd_una
+    bool predicted_ack_received(const WrappingInt32 ackno);
+
     //! \brief Generate an empty-payload segment (useful for creating empty ACK segments)
     void send_empty_segment();
 
+    //! \brief Generate a keepalive probe: an empty segment that the peer must acknowledge
+    void send_keepalive_probe();
+
     //! \brief create and send segments to fill as much of the window as possible
     void fill_window();
 
+    //! \brief Stop (or resume) sending new data while the device below would block; retransmissions
+    //! and empty segments are still sent
+    void set_output_blocked(const bool blocked) { _output_blocked = blocked; }
+
     //! \brief Notifies the TCPSender of the passage of time
-    void tick(const size_t ms_since_last_tick);
+    void tick(const size_t ms_since_last_tick) { tick_us(ms_since_last_tick * 1000); }
+
+    //! \brief Notifies the TCPSender of the passage of time, in microseconds
+    void tick_us(const uint64_t us_since_last_tick);
+
+    //! \brief Milliseconds until tick() next has something to do (empty if the timer is stopped)
+    std::optional<size_t> next_deadline() const;
+
+    //! \brief Microseconds until tick_us() next has something to do (empty if the timer is stopped)
+    std::optional<uint64_t> next_deadline_us() const;
     //!@}
 
     //! \name Accessors
@@ -110,11 +186,46 @@ class TCPSender {
     //! \brief Number of consecutive retransmissions that have occurred in a row
     unsigned int consecutive_retransmissions() const;
 
+    //! \brief Smoothed round-trip time in milliseconds (at least 1), or 0 if no RTT has been sampled yet
+    //! \note Samples follow Karn's algorithm: segments that were retransmitted are never timed
+    size_t srtt() const { return _srtt ? std::max(_srtt / 1000, static_cast<uint64_t>(1)) : 0; }
+
+    //! \brief Round-trip time variation in milliseconds
+    size_t rttvar() const { return _rttvar / 1000; }
+
+    //! \brief Smoothed round-trip time in microseconds, or 0 if no RTT has been sampled yet
+    uint64_t srtt_us() const { return _srtt; }
+
+    //! \brief Round-trip time variation in microseconds
+    uint64_t rttvar_us() const { return _rttvar; }
+
+    //! \brief relative seqno of the oldest unacknowledged byte (snd_una)
+    WrappingInt32 unacked_seqno() const { return wrap(_max_seqno_acked, _isn); }
+
+    //! \brief Has the SYN been acknowledged?
+    bool syn_acked() const { return _ack_seen && _max_seqno_acked > 0; }
+
+    //! \brief The window most recently advertised by the peer
+    uint64_t peer_window() const { return _window_size; }
+
+    //! \brief Is sending new data held back by set_output_blocked()?
+    bool output_blocked() const { return _output_blocked; }
+
     //! \brief TCPSegments that the TCPSender has enqueued for transmission.
     //! \note These must be dequeued and sent by the TCPConnection,
     //! which will need to fill in the fields that are set by the TCPReceiver
     //! (ackno and window size) before sending.
-    std::queue<TCPSegment> &segments_out() { return _segments_out; }
+    RingQueue<TCPSegment> &segments_out() { return _segments_out; }
+    //!@}
+
+    //! \name Memory
+    //!@{
+
+    //! \brief Bytes of heap storage held by the sender: its stream, queues and outstanding payloads
+    size_t memory_usage() const;
+
+    //! \brief Free the storage of the queues that are empty
+    void shrink_to_fit();
     //!@}
 
     //! \name What is the next sequence number? (used for testing)
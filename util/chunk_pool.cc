@@ -0,0 +1,42 @@
+#include "chunk_pool.hh"
+
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+//! This thread's free list
+struct FreeList {
+    vector<ChunkPool::Chunk> chunks{};
+    ~FreeList();
+};
+
+thread_local FreeList free_list{};
+
+//! Set once the free list has been destroyed at thread exit; chunks released after that
+//! (e.g. by a stream in a static object) are deleted
+thread_local bool free_list_destroyed = false;
+
+FreeList::~FreeList() { free_list_destroyed = true; }
+
+}  // namespace
+
+ChunkPool::Chunk ChunkPool::acquire() {
+    if (free_list_destroyed or free_list.chunks.empty()) {
+        return Chunk(new char[CHUNK_SIZE]);  // not make_unique, which would zero it
+    }
+    Chunk chunk = move(free_list.chunks.back());
+    free_list.chunks.pop_back();
+    return chunk;
+}
+
+void ChunkPool::release(Chunk &&chunk) {
+    if (free_list_destroyed or free_list.chunks.size() >= MAX_FREE) {
+        chunk.reset();
+        return;
+    }
+    free_list.chunks.push_back(move(chunk));
+}
+
+size_t ChunkPool::free_count() { return free_list_destroyed ? 0 : free_list.chunks.size(); }
@@ -0,0 +1,30 @@
+#ifndef SPONGE_LIBSPONGE_CHUNK_POOL_HH
+#define SPONGE_LIBSPONGE_CHUNK_POOL_HH
+
+#include <cstddef>
+#include <memory>
+
+//! \brief Fixed-size chunks of memory for stream buffers, recycled through a per-thread free list
+//! \details A ByteStream takes chunks as data is written and gives them back as it is read, so an
+//! idle stream holds none, and a busy one reuses chunks that other streams have drained instead of
+//! going to the allocator. Each thread has its own free list (so no locking is needed); a chunk
+//! may be released on a different thread from the one that acquired it.
+class ChunkPool {
+  public:
+    static constexpr size_t CHUNK_SIZE = 4096;  //!< Bytes in a chunk
+    static constexpr size_t MAX_FREE = 1024;    //!< Free chunks kept per thread; more are deleted
+
+    //! Storage of one chunk
+    using Chunk = std::unique_ptr<char[]>;
+
+    //! \returns a chunk, from the free list if possible
+    static Chunk acquire();
+
+    //! Return a chunk to the free list
+    static void release(Chunk &&chunk);
+
+    //! \returns the number of chunks in this thread's free list
+    static size_t free_count();
+};
+
+#endif  // SPONGE_LIBSPONGE_CHUNK_POOL_HH
@@ -3,6 +3,7 @@
 
 #include "file_descriptor.hh"
 
+#include <cstdint>
 #include <cstdlib>
 #include <functional>
 #include <list>
@@ -55,6 +56,9 @@ class EventLoop {
 
     //! Calls [poll(2)](\ref man2::poll) and then executes callback for each ready fd.
     Result wait_next_event(const int timeout_ms);
+
+    //! Like wait_next_event(), with the timeout in microseconds (uses [ppoll(2)](\ref man2::ppoll)).
+    Result wait_next_event_us(const int64_t timeout_us);
 };
 
 using Direction = EventLoop::Direction;
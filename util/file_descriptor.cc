@@ -3,6 +3,7 @@
 #include "util.hh"
 
 #include <algorithm>
+#include <cerrno>
 #include <fcntl.h>
 #include <iostream>
 #include <stdexcept>
@@ -63,6 +64,27 @@ void FileDescriptor::read(std::string &str, const size_t limit) {
     register_read();
 }
 
+//! \param[in] limit is the maximum number of bytes to read; fewer bytes may be returned
+//! \param[out] str is the string to be read (left empty if the read would block)
+//! \returns `false` if nothing could be read without blocking (the fd must have been set non-blocking)
+bool FileDescriptor::try_read(std::string &str, const size_t limit) {
+    constexpr size_t BUFFER_SIZE = 1024 * 1024;  // maximum size of a read
+    const size_t size_to_read = min(BUFFER_SIZE, limit);
+    str.resize(size_to_read);
+
+    const ssize_t bytes_read = SystemCall("read", ::read(fd_num(), str.data(), size_to_read), EAGAIN);
+    register_read();
+    if (bytes_read < 0) {
+        str.clear();
+        return false;
+    }
+    if (limit > 0 && bytes_read == 0) {
+        _internal_fd->_eof = true;
+    }
+    str.resize(bytes_read);
+    return true;
+}
+
 //! \param[in] limit is the maximum number of bytes to read; fewer bytes may be returned
 //! \returns a vector of bytes read
 string FileDescriptor::read(const size_t limit) {
@@ -98,6 +120,23 @@ size_t FileDescriptor::write(BufferViewList buffer, const bool write_all) {
     return total_bytes_written;
 }
 
+//! \param[in] buffer is one datagram, which the fd takes whole or not at all
+//! \returns `false` if nothing was written because the write would block (the fd must have been set non-blocking)
+bool FileDescriptor::try_write(const BufferViewList &buffer) {
+    auto iovecs = buffer.as_iovecs();
+
+    const ssize_t bytes_written = SystemCall("writev", ::writev(fd_num(), iovecs.data(), iovecs.size()), EAGAIN);
+    if (bytes_written < 0) {
+        return false;
+    }
+    if (size_t(bytes_written) != buffer.size()) {
+        throw runtime_error("writev wrote part of a datagram");
+    }
+
+    register_write();
+    return true;
+}
+
 void FileDescriptor::set_blocking(const bool blocking_state) {
     int flags = SystemCall("fcntl", fcntl(fd_num(), F_GETFL));
     if (blocking_state) {
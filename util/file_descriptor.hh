@@ -61,6 +61,9 @@ class FileDescriptor {
     //! Read up to `limit` bytes into `str` (caller can allocate storage)
     void read(std::string &str, const size_t limit = std::numeric_limits<size_t>::max());
 
+    //! Read up to `limit` bytes into `str` from a non-blocking fd, unless the read would block
+    bool try_read(std::string &str, const size_t limit = std::numeric_limits<size_t>::max());
+
     //! Write a string, possibly blocking until all is written
     size_t write(const char *str, const bool write_all = true) { return write(BufferViewList(str), write_all); }
 
@@ -70,6 +73,9 @@ class FileDescriptor {
     //! Write a buffer (or list of buffers), possibly blocking until all is written
     size_t write(BufferViewList buffer, const bool write_all = true);
 
+    //! Write a whole datagram (e.g. to a TUN device) to a non-blocking fd, unless the write would block
+    bool try_write(const BufferViewList &buffer);
+
     //! Close the underlying file descriptor
     void close() { _internal_fd->close(); }
 
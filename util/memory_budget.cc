@@ -0,0 +1,53 @@
+#include "memory_budget.hh"
+
+#include <stdexcept>
+
+using namespace std;
+
+MemoryBudget &MemoryBudget::global() {
+    static MemoryBudget budget;
+    return budget;
+}
+
+void MemoryBudget::set_limits(const size_t low, const size_t pressure, const size_t high) {
+    if (low > pressure or pressure > high) {
+        throw runtime_error("MemoryBudget: thresholds must satisfy low <= pressure <= high");
+    }
+    _low = low;
+    _pressure = pressure;
+    _high = high;
+    update_pressure(used());
+}
+
+void MemoryBudget::charge(const size_t bytes) {
+    update_pressure(_used.fetch_add(bytes, memory_order_relaxed) + bytes);
+}
+
+void MemoryBudget::uncharge(const size_t bytes) {
+    update_pressure(_used.fetch_sub(bytes, memory_order_relaxed) - bytes);
+}
+
+void MemoryBudget::update_pressure(const size_t used) {
+    if (used > _pressure.load(memory_order_relaxed)) {
+        _under_pressure.store(true, memory_order_relaxed);
+    } else if (used < _low.load(memory_order_relaxed)) {
+        _under_pressure.store(false, memory_order_relaxed);
+    }
+}
+
+MemoryCharge &MemoryCharge::operator=(MemoryCharge &&other) noexcept {
+    if (this != &other) {
+        set(0);
+        _bytes = exchange(other._bytes, 0);
+    }
+    return *this;
+}
+
+void MemoryCharge::set(const size_t bytes) {
+    if (bytes > _bytes) {
+        MemoryBudget::global().charge(bytes - _bytes);
+    } else if (bytes < _bytes) {
+        MemoryBudget::global().uncharge(_bytes - bytes);
+    }
+    _bytes = bytes;
+}
@@ -0,0 +1,71 @@
+#ifndef SPONGE_LIBSPONGE_MEMORY_BUDGET_HH
+#define SPONGE_LIBSPONGE_MEMORY_BUDGET_HH
+
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <utility>
+
+//! \brief Process-wide accounting of the memory held in TCP buffers, with thresholds like
+//! Linux's `tcp_mem` (low, pressure, high)
+//! \details Streams, reassemblers and senders (for the payloads awaiting acknowledgment) charge
+//! the bytes they hold to the global budget. Above the `pressure` threshold the budget is under
+//! pressure until usage falls back below `low`; in that state receive buffers return to their
+//! initial size and send buffers stop growing. Above `high` the budget is exhausted, and receivers
+//! stop opening their windows. By default there are no limits.
+class MemoryBudget {
+  private:
+    std::atomic<size_t> _used{0};
+    std::atomic<size_t> _low{std::numeric_limits<size_t>::max()};
+    std::atomic<size_t> _pressure{std::numeric_limits<size_t>::max()};
+    std::atomic<size_t> _high{std::numeric_limits<size_t>::max()};
+    std::atomic<bool> _under_pressure{false};
+
+    //! Enter or leave the pressure state after usage has changed to `used`
+    void update_pressure(const size_t used);
+
+  public:
+    //! \returns the budget shared by the whole process
+    static MemoryBudget &global();
+
+    //! \brief Set the thresholds, in bytes (`low` <= `pressure` <= `high`)
+    void set_limits(const size_t low, const size_t pressure, const size_t high);
+
+    //! Account for `bytes` more memory held
+    void charge(const size_t bytes);
+
+    //! Account for `bytes` of memory given back
+    void uncharge(const size_t bytes);
+
+    //! \returns the bytes currently charged
+    size_t used() const { return _used.load(std::memory_order_relaxed); }
+
+    //! \returns `true` if usage has passed `pressure` and not yet fallen below `low`
+    bool under_pressure() const { return _under_pressure.load(std::memory_order_relaxed); }
+
+    //! \returns `true` if usage is above `high`
+    bool exhausted() const { return used() > _high.load(std::memory_order_relaxed); }
+};
+
+//! \brief The bytes that one buffer has charged to the global MemoryBudget; they are uncharged
+//! when it is destroyed, and move with it
+class MemoryCharge {
+  private:
+    size_t _bytes{0};
+
+  public:
+    MemoryCharge() = default;
+    MemoryCharge(const MemoryCharge &other) = delete;
+    MemoryCharge &operator=(const MemoryCharge &other) = delete;
+    MemoryCharge(MemoryCharge &&other) noexcept : _bytes(std::exchange(other._bytes, 0)) {}
+    MemoryCharge &operator=(MemoryCharge &&other) noexcept;
+    ~MemoryCharge() { set(0); }
+
+    //! Charge or uncharge the difference so that `bytes` are charged
+    void set(const size_t bytes);
+
+    //! \returns the bytes charged
+    size_t bytes() const { return _bytes; }
+};
+
+#endif  // SPONGE_LIBSPONGE_MEMORY_BUDGET_HH
@@ -0,0 +1,117 @@
+#ifndef SPONGE_LIBSPONGE_RING_QUEUE_HH
+#define SPONGE_LIBSPONGE_RING_QUEUE_HH
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+//! \brief A FIFO queue stored in a ring of preallocated slots
+//! \details Offers the std::queue interface used for outbound segments, but pushing (by move) and
+//! popping do not allocate: elements are moved into and out of slots that are reused. The slots are
+//! allocated by the first push, and the ring only grows (doubling) if it is ever full, so a queue
+//! that is drained regularly allocates once; shrink_to_fit() gives the slots of an empty queue back.
+template <typename T>
+class RingQueue {
+  private:
+    std::vector<T> _slots;  //!< storage; its size is zero or a power of two
+    size_t _head{0};        //!< slot of the front element
+    size_t _size{0};        //!< number of elements in the queue
+    size_t _initial_slots;  //!< number of slots allocated by the first push
+
+    size_t slot(const size_t i) const { return (_head + i) & (_slots.size() - 1); }
+
+    //! Double the number of slots, keeping the elements in order
+    void grow() {
+        std::vector<T> slots(_slots.empty() ? _initial_slots : _slots.size() * 2);
+        for (size_t i = 0; i < _size; i++) {
+            slots[i] = std::move(_slots[slot(i)]);
+        }
+        _slots = std::move(slots);
+        _head = 0;
+    }
+
+  public:
+    //! Number of slots allocated by default
+    static constexpr size_t DEFAULT_CAPACITY = 64;
+
+    //! \param[in] capacity the number of slots to allocate on the first push (rounded up to a power of two)
+    explicit RingQueue(const size_t capacity = DEFAULT_CAPACITY) : _slots(), _initial_slots(1) {
+        while (_initial_slots < capacity) {
+            _initial_slots *= 2;
+        }
+    }
+
+    RingQueue(const RingQueue &other) = default;
+    RingQueue &operator=(const RingQueue &other) = default;
+
+    //! The moved-from queue is left empty
+    RingQueue(RingQueue &&other) noexcept
+        : _slots(std::move(other._slots)), _head(other._head), _size(other._size), _initial_slots(other._initial_slots) {
+        other._slots.clear();
+        other._head = other._size = 0;
+    }
+
+    //! The moved-from queue is left empty
+    RingQueue &operator=(RingQueue &&other) noexcept {
+        if (this != &other) {
+            _slots = std::move(other._slots);
+            _head = other._head;
+            _size = other._size;
+            _initial_slots = other._initial_slots;
+            other._slots.clear();
+            other._head = other._size = 0;
+        }
+        return *this;
+    }
+
+    //! \name std::queue interface
+    //!@{
+    bool empty() const { return _size == 0; }
+    size_t size() const { return _size; }
+    T &front() { return _slots[_head]; }
+    const T &front() const { return _slots[_head]; }
+    T &back() { return _slots[slot(_size - 1)]; }
+    const T &back() const { return _slots[slot(_size - 1)]; }
+
+    void push(const T &value) { push(T(value)); }
+    void push(T &&value) {
+        if (_size == _slots.size()) {
+            grow();
+        }
+        _slots[slot(_size)] = std::move(value);
+        _size++;
+    }
+
+    //! \note The vacated slot is reset, so it does not keep the popped element's resources alive.
+    //! A copyable element is reset by assignment from a shared empty one, which frees what it held
+    //! and keeps its own storage (a default-constructed std::deque, as in a BufferList, would allocate).
+    void pop() {
+        if constexpr (std::is_copy_assignable_v<T>) {
+            static const T empty{};
+            _slots[_head] = empty;
+        } else {
+            _slots[_head] = T();
+        }
+        _head = slot(1);
+        _size--;
+    }
+    //!@}
+
+    //! \brief The `i`th element from the front
+    T &operator[](const size_t i) { return _slots[slot(i)]; }
+    const T &operator[](const size_t i) const { return _slots[slot(i)]; }
+
+    //! \brief Number of elements the queue can hold before it has to grow
+    size_t capacity() const { return _slots.size(); }
+
+    //! \brief Free the slots if the queue is empty (the next push allocates them again)
+    void shrink_to_fit() {
+        if (_size == 0) {
+            std::vector<T>().swap(_slots);
+            _head = 0;
+        }
+    }
+};
+
+#endif  // SPONGE_LIBSPONGE_RING_QUEUE_HH
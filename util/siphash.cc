@@ -0,0 +1,74 @@
+#include "siphash.hh"
+
+#include <random>
+
+using namespace std;
+
+namespace {
+
+uint64_t rotl(const uint64_t x, const int b) { return (x << b) | (x >> (64 - b)); }
+
+void sip_round(uint64_t &v0, uint64_t &v1, uint64_t &v2, uint64_t &v3) {
+    v0 += v1;
+    v1 = rotl(v1, 13);
+    v1 ^= v0;
+    v0 = rotl(v0, 32);
+    v2 += v3;
+    v3 = rotl(v3, 16);
+    v3 ^= v2;
+    v0 += v3;
+    v3 = rotl(v3, 21);
+    v3 ^= v0;
+    v2 += v1;
+    v1 = rotl(v1, 17);
+    v1 ^= v2;
+    v2 = rotl(v2, 32);
+}
+
+//! \returns the little-endian 64-bit word of the `len` (at most 8) bytes at `p`
+uint64_t load_le(const uint8_t *p, const size_t len) {
+    uint64_t word = 0;
+    for (size_t i = 0; i < len; i++) {
+        word |= uint64_t{p[i]} << (8 * i);
+    }
+    return word;
+}
+
+}  // namespace
+
+SipHash SipHash::with_random_key() {
+    random_device rd;
+    const uint64_t k0 = uint64_t{rd()} << 32 | rd();
+    const uint64_t k1 = uint64_t{rd()} << 32 | rd();
+    return {k0, k1};
+}
+
+uint64_t SipHash::operator()(const void *data, const size_t len) const {
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    uint64_t v0 = _k0 ^ 0x736f6d6570736575;
+    uint64_t v1 = _k1 ^ 0x646f72616e646f6d;
+    uint64_t v2 = _k0 ^ 0x6c7967656e657261;
+    uint64_t v3 = _k1 ^ 0x7465646279746573;
+
+    const size_t whole = len - len % 8;
+    for (size_t i = 0; i < whole; i += 8) {
+        const uint64_t m = load_le(bytes + i, 8);
+        v3 ^= m;
+        sip_round(v0, v1, v2, v3);
+        sip_round(v0, v1, v2, v3);
+        v0 ^= m;
+    }
+
+    // the final word holds the remaining bytes and, in its top byte, the length
+    const uint64_t last = load_le(bytes + whole, len % 8) | uint64_t{len & 0xff} << 56;
+    v3 ^= last;
+    sip_round(v0, v1, v2, v3);
+    sip_round(v0, v1, v2, v3);
+    v0 ^= last;
+
+    v2 ^= 0xff;
+    for (int i = 0; i < 4; i++) {
+        sip_round(v0, v1, v2, v3);
+    }
+    return v0 ^ v1 ^ v2 ^ v3;
+}
@@ -0,0 +1,28 @@
+#ifndef SPONGE_LIBSPONGE_SIPHASH_HH
+#define SPONGE_LIBSPONGE_SIPHASH_HH
+
+#include <cstddef>
+#include <cstdint>
+
+//! \brief [SipHash-2-4](https://www.aumasson.jp/siphash/siphash.pdf), a keyed hash (PRF)
+//! \details Unlike the hash of an unordered container, the output cannot be predicted or steered
+//! without the 128-bit key, so it can protect values an attacker must not guess, such as SYN
+//! cookies and initial sequence numbers.
+class SipHash {
+  private:
+    uint64_t _k0;
+    uint64_t _k1;
+
+  public:
+    //! \param[in] k0 the first half of the key
+    //! \param[in] k1 the second half of the key
+    SipHash(const uint64_t k0, const uint64_t k1) : _k0(k0), _k1(k1) {}
+
+    //! \returns a SipHash with a key drawn from the system's random device
+    static SipHash with_random_key();
+
+    //! \returns the 64-bit hash of the `len` bytes at `data`
+    uint64_t operator()(const void *data, const size_t len) const;
+};
+
+#endif  // SPONGE_LIBSPONGE_SIPHASH_HH
@@ -2,6 +2,7 @@
 
 #include "util.hh"
 
+#include <cerrno>
 #include <cstddef>
 #include <stdexcept>
 #include <unistd.h>
@@ -106,16 +107,49 @@ void UDPSocket::recv(received_datagram &datagram, const size_t mtu) {
     datagram.payload.resize(recv_len);
 }
 
+//! \returns `false` if no datagram was waiting
+//! \note If `mtu` is too small to hold the received datagram, this method throws a std::runtime_error
+bool UDPSocket::try_recv(received_datagram &datagram, const size_t mtu) {
+    Address::Raw datagram_source_address;
+    datagram.payload.resize(mtu);
+
+    socklen_t fromlen = sizeof(datagram_source_address);
+
+    const ssize_t recv_len = SystemCall("recvfrom",
+                                        ::recvfrom(fd_num(),
+                                                   datagram.payload.data(),
+                                                   datagram.payload.size(),
+                                                   MSG_TRUNC | MSG_DONTWAIT,
+                                                   datagram_source_address,
+                                                   &fromlen),
+                                        EAGAIN);
+    register_read();
+    if (recv_len < 0) {
+        datagram.payload.clear();
+        return false;
+    }
+
+    if (recv_len > ssize_t(mtu)) {
+        throw runtime_error("recvfrom (oversized datagram)");
+    }
+
+    datagram.source_address = {datagram_source_address, fromlen};
+    datagram.payload.resize(recv_len);
+    return true;
+}
+
 UDPSocket::received_datagram UDPSocket::recv(const size_t mtu) {
     received_datagram ret{{nullptr, 0}, ""};
     recv(ret, mtu);
     return ret;
 }
 
-void sendmsg_helper(const int fd_num,
+//! \returns `false` if the send would block (only possible with MSG_DONTWAIT in `flags`)
+bool sendmsg_helper(const int fd_num,
                     const sockaddr *destination_address,
                     const socklen_t destination_address_len,
-                    const BufferViewList &payload) {
+                    const BufferViewList &payload,
+                    const int flags = 0) {
     auto iovecs = payload.as_iovecs();
 
     msghdr message{};
@@ -124,11 +158,16 @@ void sendmsg_helper(const int fd_num,
     message.msg_iov = iovecs.data();
     message.msg_iovlen = iovecs.size();
 
-    const ssize_t bytes_sent = SystemCall("sendmsg", ::sendmsg(fd_num, &message, 0));
+    const ssize_t bytes_sent =
+        SystemCall("sendmsg", ::sendmsg(fd_num, &message, flags), (flags & MSG_DONTWAIT) ? EAGAIN : 0);
+    if (bytes_sent < 0) {
+        return false;
+    }
 
     if (size_t(bytes_sent) != payload.size()) {
         throw runtime_error("datagram payload too big for sendmsg()");
     }
+    return true;
 }
 
 void UDPSocket::sendto(const Address &destination, const BufferViewList &payload) {
@@ -136,6 +175,50 @@ void UDPSocket::sendto(const Address &destination, const BufferViewList &payload
     register_write();
 }
 
+//! \returns `false` if nothing was sent because the socket's send buffer is full
+bool UDPSocket::try_sendto(const Address &destination, const BufferViewList &payload) {
+    if (not sendmsg_helper(fd_num(), destination, destination.size(), payload, MSG_DONTWAIT)) {
+        return false;
+    }
+    register_write();
+    return true;
+}
+
+//! \details Uses [sendmmsg(2)](\ref man2::sendmmsg), repeating the call until every datagram has
+//! been sent or the socket would block.
+//! \returns the number of datagrams sent, from the front of `payloads`; fewer than all of them
+//! if the socket's send buffer filled up
+size_t UDPSocket::try_sendto_batch(const Address &destination, const vector<BufferList> &payloads) {
+    vector<vector<iovec>> iovecs;
+    vector<mmsghdr> messages(payloads.size());
+    iovecs.reserve(payloads.size());
+    for (size_t i = 0; i < payloads.size(); i++) {
+        iovecs.push_back(BufferViewList(payloads[i]).as_iovecs());
+        msghdr &message = messages[i].msg_hdr;
+        message.msg_name = const_cast<sockaddr *>(static_cast<const sockaddr *>(destination));
+        message.msg_namelen = destination.size();
+        message.msg_iov = iovecs.back().data();
+        message.msg_iovlen = iovecs.back().size();
+    }
+
+    size_t sent = 0;
+    while (sent < messages.size()) {
+        const int count = SystemCall(
+            "sendmmsg", ::sendmmsg(fd_num(), messages.data() + sent, messages.size() - sent, MSG_DONTWAIT), EAGAIN);
+        if (count < 0) {
+            break;
+        }
+        for (int i = 0; i < count; i++) {
+            if (messages[sent + i].msg_len != payloads[sent + i].size()) {
+                throw runtime_error("datagram payload too big for sendmmsg()");
+            }
+        }
+        sent += count;
+        register_write();
+    }
+    return sent;
+}
+
 void UDPSocket::send(const BufferViewList &payload) {
     sendmsg_helper(fd_num(), nullptr, 0, payload);
     register_write();
@@ -8,6 +8,7 @@
 #include <functional>
 #include <string>
 #include <sys/socket.h>
+#include <vector>
 
 //! \brief Base class for network sockets (TCP, UDP, etc.)
 //! \details Socket is generally used via a subclass. See TCPSocket and UDPSocket for usage examples.
@@ -70,9 +71,19 @@ class UDPSocket : public Socket {
     //! Receive a datagram and the Address of its sender (caller can allocate storage)
     void recv(received_datagram &datagram, const size_t mtu = 65536);
 
+    //! Receive a datagram if one is already waiting, without blocking
+    bool try_recv(received_datagram &datagram, const size_t mtu = 65536);
+
     //! Send a datagram to specified Address
     void sendto(const Address &destination, const BufferViewList &payload);
 
+    //! Send a datagram to specified Address, unless the socket's send buffer is full
+    bool try_sendto(const Address &destination, const BufferViewList &payload);
+
+    //! Send as many of a batch of datagrams to specified Address as fit in the socket's send buffer,
+    //! with as few system calls as possible
+    size_t try_sendto_batch(const Address &destination, const std::vector<BufferList> &payloads);
+
     //! Send datagram to the socket's connected address (must call connect() first)
     void send(const BufferViewList &payload);
 };
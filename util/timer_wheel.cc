@@ -0,0 +1,209 @@
+#include "timer_wheel.hh"
+
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+
+static_assert(TimerWheel::SLOTS == 64, "TimerWheel: the occupancy bitmap of a level is one uint64_t");
+
+//! \returns `bits` rotated right by `n` (less than 64) places
+static uint64_t rotate_right(const uint64_t bits, const unsigned n) {
+    return n == 0 ? bits : (bits >> n) | (bits << (64 - n));
+}
+
+TimerWheel::TimerWheel(const uint64_t granularity_us) : _granularity_us(granularity_us) {
+    if (granularity_us == 0) {
+        throw runtime_error("TimerWheel: granularity must be nonzero");
+    }
+    for (auto &level : _slots) {
+        level.fill(NO_TIMER);
+    }
+}
+
+//! \param[in] callback is called from advance() each time the timer expires; it may arm,
+//! disarm, create or destroy any timer, including its own
+TimerWheel::TimerId TimerWheel::create(CallbackT callback) {
+    TimerId id;
+    if (not _free.empty()) {
+        id = _free.back();
+        _free.pop_back();
+    } else {
+        if (_timers.size() >= NO_TIMER) {
+            throw runtime_error("TimerWheel: too many timers");
+        }
+        id = _timers.size();
+        _timers.emplace_back();
+    }
+    Timer &timer = _timers[id];
+    timer = Timer{};
+    timer.callback = move(callback);
+    timer.in_use = true;
+    return id;
+}
+
+void TimerWheel::destroy(const TimerId id) {
+    disarm(id);
+    Timer &timer = _timers.at(id);
+    if (not timer.in_use) {
+        throw runtime_error("TimerWheel: destroying a timer that does not exist");
+    }
+    timer = Timer{};
+    _free.push_back(id);
+}
+
+//! \details A time that has already passed expires at the next advance() that reaches a new tick.
+void TimerWheel::arm(const TimerId id, const uint64_t expiry_us) {
+    disarm(id);
+    Timer &timer = _timers.at(id);
+    if (not timer.in_use) {
+        throw runtime_error("TimerWheel: arming a timer that does not exist");
+    }
+    const uint64_t tick = (expiry_us + _granularity_us - 1) / _granularity_us;
+    timer.expiry_tick = max(tick, _current_tick + 1);
+    timer.armed = true;
+    link(id);
+    _armed_count++;
+}
+
+void TimerWheel::disarm(const TimerId id) {
+    Timer &timer = _timers.at(id);
+    timer.firing = false;
+    if (not timer.armed) {
+        return;
+    }
+    unlink(id);
+    timer.armed = false;
+    _armed_count--;
+}
+
+//! \details Jumps from one tick with something to do to the next, so the ticks in between cost nothing.
+void TimerWheel::advance(const uint64_t now_us) {
+    const uint64_t now_tick = now_us / _granularity_us;
+    if (now_tick <= _current_tick) {
+        return;
+    }
+
+    while (_armed_count > 0) {
+        const uint64_t tick = next_event_tick();
+        if (tick > now_tick) {
+            break;
+        }
+        process_tick(tick);
+    }
+    _current_tick = now_tick;
+
+    // run the callbacks only once the wheel is consistent, since they may re-arm timers
+    for (size_t i = 0; i < _expired.size(); i++) {
+        Timer &timer = _timers[_expired[i]];
+        if (timer.firing) {
+            timer.firing = false;
+            const CallbackT callback = timer.callback;
+            callback();
+        }
+    }
+    _expired.clear();
+}
+
+optional<uint64_t> TimerWheel::next_expiry_us() const {
+    if (_armed_count == 0) {
+        return {};
+    }
+    return next_event_tick() * _granularity_us;
+}
+
+//! \details For each level with an occupied slot, finds the first occupied slot at or after the
+//! one that `_current_tick + 1` falls in (or, above level 0, the first slot starting after it).
+uint64_t TimerWheel::next_event_tick() const {
+    const uint64_t tick = _current_tick + 1;
+    uint64_t earliest = numeric_limits<uint64_t>::max();
+    for (unsigned level = 0; level < LEVELS; level++) {
+        if (_occupied[level] == 0) {
+            continue;
+        }
+        const unsigned shift = level * SLOT_BITS;
+        const uint64_t first_slot = (tick + (uint64_t{1} << shift) - 1) >> shift;
+        const uint64_t rotated = rotate_right(_occupied[level], first_slot & (SLOTS - 1));
+        earliest = min(earliest, (first_slot + __builtin_ctzll(rotated)) << shift);
+    }
+    return earliest;
+}
+
+//! \details The higher levels are cascaded first, so that a timer cascaded into a lower slot that
+//! also starts at `tick` is cascaded again (or collected) in the same call.
+void TimerWheel::process_tick(const uint64_t tick) {
+    _current_tick = tick - 1;  // cascaded timers are placed as seen from `tick`
+    for (unsigned level = LEVELS - 1; level > 0; level--) {
+        const unsigned shift = level * SLOT_BITS;
+        if ((tick & ((uint64_t{1} << shift) - 1)) != 0) {
+            continue;
+        }
+        const size_t slot = (tick >> shift) & (SLOTS - 1);
+        TimerId id = _slots[level][slot];
+        _slots[level][slot] = NO_TIMER;
+        _occupied[level] &= ~(uint64_t{1} << slot);
+        while (id != NO_TIMER) {
+            const TimerId next = _timers[id].next;
+            link(id);
+            id = next;
+        }
+    }
+
+    const size_t slot = tick & (SLOTS - 1);
+    TimerId id = _slots[0][slot];
+    _slots[0][slot] = NO_TIMER;
+    _occupied[0] &= ~(uint64_t{1} << slot);
+    while (id != NO_TIMER) {
+        Timer &timer = _timers[id];
+        const TimerId next = timer.next;
+        timer.prev = timer.next = NO_TIMER;
+        timer.armed = false;
+        timer.firing = true;
+        _armed_count--;
+        _expired.push_back(id);
+        id = next;
+    }
+    _current_tick = tick;
+}
+
+//! \details The level is the lowest whose slots, counted from the slot of `_current_tick + 1`,
+//! reach the expiry; a timer beyond the top level goes in the top level's furthest slot.
+void TimerWheel::link(const TimerId id) {
+    Timer &timer = _timers[id];
+    const uint64_t base = _current_tick + 1;
+    const uint64_t delta = timer.expiry_tick - base;
+    unsigned level = 0;
+    while (level < LEVELS - 1 and delta >= (uint64_t{1} << ((level + 1) * SLOT_BITS))) {
+        level++;
+    }
+    const uint64_t span = uint64_t{1} << (LEVELS * SLOT_BITS);
+    const uint64_t position = delta < span ? timer.expiry_tick : base + span - 1;
+    const size_t slot = (position >> (level * SLOT_BITS)) & (SLOTS - 1);
+
+    TimerId &head = _slots[level][slot];
+    timer.level = level;
+    timer.slot = slot;
+    timer.prev = NO_TIMER;
+    timer.next = head;
+    if (head != NO_TIMER) {
+        _timers[head].prev = id;
+    }
+    head = id;
+    _occupied[level] |= uint64_t{1} << slot;
+}
+
+void TimerWheel::unlink(const TimerId id) {
+    Timer &timer = _timers[id];
+    if (timer.prev != NO_TIMER) {
+        _timers[timer.prev].next = timer.next;
+    } else {
+        _slots[timer.level][timer.slot] = timer.next;
+        if (timer.next == NO_TIMER) {
+            _occupied[timer.level] &= ~(uint64_t{1} << timer.slot);
+        }
+    }
+    if (timer.next != NO_TIMER) {
+        _timers[timer.next].prev = timer.prev;
+    }
+    timer.prev = timer.next = NO_TIMER;
+}
@@ -0,0 +1,107 @@
+#ifndef SPONGE_LIBSPONGE_TIMER_WHEEL_HH
+#define SPONGE_LIBSPONGE_TIMER_WHEEL_HH
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <vector>
+
+//! \brief A hierarchical timer wheel shared by many timers (e.g. one per TCP connection)
+//! \details Time is divided into ticks of `granularity_us` microseconds. The wheel has LEVELS
+//! levels of SLOTS slots each: level 0 has one slot per tick, and each slot of level `l` spans
+//! SLOTS^l ticks. A timer is kept in a doubly-linked list in the slot of the lowest level whose
+//! span reaches its expiry, and when time reaches the start of a higher-level slot, that slot's
+//! timers are cascaded down to lower levels (Varghese and Lauck's scheme 7). Timers further out
+//! than the top level stay in its furthest slot and are cascaded back to it until they are near.
+//!
+//! Arming and disarming a timer are O(1), and each timer is cascaded at most once per level. A
+//! bitmap of the occupied slots of each level lets advance() skip straight to the next tick with
+//! something to do, and next_expiry_us() find it without visiting any timer, so idle timers are
+//! never touched. Timers fire at most one tick late, never early.
+class TimerWheel {
+  public:
+    //! Handle to a timer registered with create()
+    using TimerId = uint32_t;
+
+    //! Called when a timer expires
+    using CallbackT = std::function<void(void)>;
+
+    //! Value of a TimerId that refers to no timer
+    static constexpr TimerId NO_TIMER = std::numeric_limits<TimerId>::max();
+
+    //! Number of levels
+    static constexpr unsigned LEVELS = 6;
+
+    //! Number of slots in each level (one bit each in the occupancy bitmap)
+    static constexpr unsigned SLOTS = 64;
+
+  private:
+    //! log2(SLOTS)
+    static constexpr unsigned SLOT_BITS = 6;
+
+    //! A registered timer; an entry of the slot list it is armed in
+    struct Timer {
+        CallbackT callback{};
+        uint64_t expiry_tick{0};
+        TimerId prev{NO_TIMER};
+        TimerId next{NO_TIMER};
+        uint8_t level{0};  //!< level and slot of the list the timer is in, while armed
+        uint8_t slot{0};
+        bool in_use{false};
+        bool armed{false};
+        bool firing{false};  //!< expired in the current advance(), callback not yet run
+    };
+
+    uint64_t _granularity_us;                                   //!< length of one tick
+    std::array<std::array<TimerId, SLOTS>, LEVELS> _slots{};    //!< head of each slot's list
+    std::array<uint64_t, LEVELS> _occupied{};                   //!< bit `s` set if slot `s` of a level is non-empty
+    std::vector<Timer> _timers{};                               //!< all timers, indexed by TimerId
+    std::vector<TimerId> _free{};                               //!< unused entries of `_timers`
+    std::vector<TimerId> _expired{};  //!< timers collected by advance(), before their callbacks run
+    uint64_t _current_tick{0};        //!< the last tick processed by advance()
+    size_t _armed_count{0};           //!< number of armed timers
+
+    //! Put an armed timer in the list of the slot for its expiry, as seen from `_current_tick`
+    void link(const TimerId id);
+    void unlink(const TimerId id);
+
+    //! \returns the first tick after `_current_tick` at which a timer expires or a slot is cascaded
+    uint64_t next_event_tick() const;
+
+    //! Cascade the slots that start at `tick`, and collect the timers that expire at it
+    void process_tick(const uint64_t tick);
+
+  public:
+    //! \param[in] granularity_us the length of one tick, in microseconds
+    explicit TimerWheel(const uint64_t granularity_us = 1000);
+
+    //! Register a (disarmed) timer that will call `callback` each time it expires
+    TimerId create(CallbackT callback);
+
+    //! Disarm and forget a timer
+    void destroy(const TimerId id);
+
+    //! Arm (or re-arm) a timer to expire at the absolute time `expiry_us`
+    void arm(const TimerId id, const uint64_t expiry_us);
+
+    //! Disarm a timer, if armed
+    void disarm(const TimerId id);
+
+    //! \returns `true` if the timer is armed
+    bool armed(const TimerId id) const { return _timers.at(id).armed; }
+
+    //! Run the callbacks of all timers that expire at or before the absolute time `now_us`
+    void advance(const uint64_t now_us);
+
+    //! \returns an absolute time no later than the earliest expiry, if any timer is armed: the
+    //! expiry itself (rounded up to a tick), or the time a higher level must cascade its timers
+    std::optional<uint64_t> next_expiry_us() const;
+
+    //! \returns the number of armed timers
+    size_t armed_count() const { return _armed_count; }
+};
+
+#endif  // SPONGE_LIBSPONGE_TIMER_WHEEL_HH